@@ -7,11 +7,29 @@ mrb_mruby_openal_gem_init(mrb_state *mrb)
   mruby_openal_alc_init(mrb);
   mruby_openal_alut_init(mrb);
   mruby_openal_common_init(mrb);
+  mruby_openal_pcm_init(mrb);
+  mruby_openal_resampler_init(mrb);
+  mruby_openal_samplepool_init(mrb);
+  mruby_openal_ring_init(mrb);
+  mruby_openal_streaming_init(mrb);
+  mruby_openal_sourcepool_init(mrb);
+  mruby_openal_bankloader_init(mrb);
+  mruby_openal_stream_init(mrb);
+  mruby_openal_clock_init(mrb);
 }
 
 void
 mrb_mruby_openal_gem_final(mrb_state *mrb)
 {
+  mruby_openal_clock_final(mrb);
+  mruby_openal_stream_final(mrb);
+  mruby_openal_bankloader_final(mrb);
+  mruby_openal_sourcepool_final(mrb);
+  mruby_openal_streaming_final(mrb);
+  mruby_openal_ring_final(mrb);
+  mruby_openal_samplepool_final(mrb);
+  mruby_openal_resampler_final(mrb);
+  mruby_openal_pcm_final(mrb);
   mruby_openal_common_final(mrb);
   mruby_openal_alut_final(mrb);
   mruby_openal_alc_final(mrb);
@@ -3,27 +3,167 @@
 
 #include "mruby.h"
 #include "mruby/data.h"
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <stdbool.h>
 #include <stddef.h>
 
+#define MRB_AL_CACHE_LINE_SIZE 64
+
+/* from AL_EXT_float32. */
+#ifndef AL_FORMAT_MONO_FLOAT32
+#define AL_FORMAT_MONO_FLOAT32   0x10010
+#define AL_FORMAT_STEREO_FLOAT32 0x10011
+#endif
+
+/*
+ * reference counted storage of SampleBuffer.
+ * views share the block of their parent, so it lives until the last user is freed.
+ * blocks carved from a SampleBufferPool go back to 'pool' instead of the heap.
+ * 'external' is the heap buffer of a String used instead of 'bytes'. the
+ * String owns it and is kept in @storage by every SampleBuffer on the block.
+ * the header is kept a multiple of 16 bytes so 'bytes' stays aligned.
+ */
+struct mrb_al_sample_pool_t;
+
+typedef struct mrb_al_sample_block_t {
+  size_t                       refs;
+  size_t                       capacity;
+  struct mrb_al_sample_pool_t *pool;
+  void                        *external;
+  unsigned char                bytes[];
+} mrb_al_sample_block_t;
+
+typedef char mrb_al_sample_block_header_check_t[(0 == offsetof(mrb_al_sample_block_t, bytes) % 16) ? 1 : -1];
+
+/*
+ * 'slot' is the pooled block this header was carved next to, or NULL for a
+ * header on the heap. it holds a reference of its own, so the slot goes
+ * back to the pool only with the header, whatever 'block' is by then.
+ */
 typedef struct mrb_al_sample_buffer_data_t {
-  void  *buffer;
-  size_t capacity;
-  size_t size;
+  void                  *buffer;
+  size_t                 capacity;
+  size_t                 size;
+  mrb_al_sample_block_t *block;
+  mrb_al_sample_block_t *slot;
 } mrb_al_sample_buffer_data_t;
 
+typedef struct mrb_al_buffers_data_t {
+  ALsizei size;
+  ALuint *buffers;
+} mrb_al_buffers_data_t;
+
+typedef struct mrb_al_sources_data_t {
+  ALsizei size;
+  ALuint *sources;
+} mrb_al_sources_data_t;
+
+/*
+ * single-producer/single-consumer byte ring.
+ * 'head' is only written by the producer and 'tail' only by the consumer,
+ * each on its own cache line.
+ * 'refs' counts the owners of a ring allocated by RingBuffer, which are the
+ * RingBuffer itself and any native worker feeding it.
+ */
+typedef struct mrb_al_ring_t {
+  unsigned char *buffer;
+  size_t         capacity;
+  size_t         mask;
+  size_t         refs;
+  char           pad0[MRB_AL_CACHE_LINE_SIZE - sizeof(void*) - sizeof(size_t) * 3];
+  size_t         head;
+  char           pad1[MRB_AL_CACHE_LINE_SIZE - sizeof(size_t)];
+  size_t         tail;
+  char           pad2[MRB_AL_CACHE_LINE_SIZE - sizeof(size_t)];
+} mrb_al_ring_t;
+
+enum {
+  MRB_AL_PCM_U8,
+  MRB_AL_PCM_S16,
+  MRB_AL_PCM_F32,
+};
+
+typedef struct mrb_al_pcm_format_t {
+  int    type;
+  int    channels;
+  size_t sample_size;
+} mrb_al_pcm_format_t;
+
 extern struct mrb_data_type const mrb_al_sample_buffer_data_type;
+extern struct mrb_data_type const mrb_al_ring_data_type;
+extern struct mrb_data_type const mrb_al_buffers_data_type;
+extern struct mrb_data_type const mrb_al_sources_data_type;
 
 extern struct RClass *mod_AL;
+extern struct RClass *class_ALError;
+extern struct RClass *class_Buffers;
+extern struct RClass *class_Sources;
+extern struct RClass *class_SampleBuffer;
+
+extern ALenum mrb_al_fetch_error(void);
+extern void   mrb_al_check_error(mrb_state *mrb);
+
+extern mrb_al_sample_block_t *mrb_al_sample_block_new(mrb_state *mrb, size_t capacity);
+extern void mrb_al_sample_block_release(mrb_state *mrb, mrb_al_sample_block_t *block);
+extern void mrb_al_sample_buffer_set_block(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, mrb_al_sample_block_t *block);
+extern void mrb_al_sample_buffer_reserve(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, size_t capacity);
+extern void mrb_al_sample_pool_put(mrb_state *mrb, struct mrb_al_sample_pool_t *pool, mrb_al_sample_block_t *block);
+
+extern size_t mrb_al_format_frame_size(ALenum format);
+extern char const *mrb_al_parse_wave(unsigned char const *image, size_t size, ALenum *format, ALsizei *frequency, unsigned char const **pcm, size_t *pcm_size);
+extern char const *mrb_al_decode_file(char const *path, ALenum *format, ALsizei *frequency, unsigned char **pcm, size_t *pcm_size);
+
+extern void  mrb_al_pcm_get_format(mrb_state *mrb, mrb_int format, mrb_al_pcm_format_t *info);
+extern void  mrb_al_pcm_decode(float *dst, void const *src, int type, size_t count);
+extern void  mrb_al_pcm_encode(void *dst, float const *src, int type, size_t count);
+extern float mrb_al_pcm_dot(float const *a, float const *b, size_t count);
+
+extern ALCdevice *mrb_alc_context_device(mrb_state *mrb, mrb_value context);
+
+extern mrb_value mrb_al_source_wrap(mrb_state *mrb, ALuint source);
+extern ALuint    mrb_al_source_name(mrb_state *mrb, mrb_value source);
+extern mrb_value mrb_al_sources_at(mrb_state *mrb, mrb_value sources, ALsizei index);
+extern bool      mrb_al_source_offset_latency(ALuint source, double *offset, double *latency);
+extern bool      mrb_al_stream_position(mrb_value stream, ALuint *source, double *offset, double *latency, bool *exact);
+extern bool      mrb_al_streaming_source_position(mrb_value stream, ALuint *source, double *offset, double *latency, bool *exact);
+
+extern void   mrb_al_ring_init(mrb_state *mrb, mrb_al_ring_t *ring, size_t capacity);
+extern void   mrb_al_ring_destroy(mrb_state *mrb, mrb_al_ring_t *ring);
+extern void   mrb_al_ring_retain(mrb_al_ring_t *ring);
+extern void   mrb_al_ring_release(mrb_state *mrb, mrb_al_ring_t *ring);
+extern size_t mrb_al_ring_available(mrb_al_ring_t *ring);
+extern size_t mrb_al_ring_free_space(mrb_al_ring_t *ring);
+extern size_t mrb_al_ring_write(mrb_al_ring_t *ring, void const *src, size_t size);
+extern size_t mrb_al_ring_read(mrb_al_ring_t *ring, void *dst, size_t size);
 
 extern void mruby_openal_common_init(mrb_state *mrb);
 extern void mruby_openal_common_final(mrb_state *mrb);
+extern void mruby_openal_pcm_init(mrb_state *mrb);
+extern void mruby_openal_pcm_final(mrb_state *mrb);
+extern void mruby_openal_resampler_init(mrb_state *mrb);
+extern void mruby_openal_resampler_final(mrb_state *mrb);
+extern void mruby_openal_samplepool_init(mrb_state *mrb);
+extern void mruby_openal_samplepool_final(mrb_state *mrb);
 
 extern void mruby_openal_al_init(mrb_state *mrb);
 extern void mruby_openal_alc_init(mrb_state *mrb);
 extern void mruby_openal_alut_init(mrb_state *mrb);
+extern void mruby_openal_ring_init(mrb_state *mrb);
+extern void mruby_openal_streaming_init(mrb_state *mrb);
+extern void mruby_openal_sourcepool_init(mrb_state *mrb);
+extern void mruby_openal_bankloader_init(mrb_state *mrb);
+extern void mruby_openal_stream_init(mrb_state *mrb);
+extern void mruby_openal_clock_init(mrb_state *mrb);
 extern void mruby_openal_al_final(mrb_state *mrb);
 extern void mruby_openal_alc_final(mrb_state *mrb);
 extern void mruby_openal_alut_final(mrb_state *mrb);
+extern void mruby_openal_ring_final(mrb_state *mrb);
+extern void mruby_openal_streaming_final(mrb_state *mrb);
+extern void mruby_openal_sourcepool_final(mrb_state *mrb);
+extern void mruby_openal_bankloader_final(mrb_state *mrb);
+extern void mruby_openal_stream_final(mrb_state *mrb);
+extern void mruby_openal_clock_final(mrb_state *mrb);
 
 #endif /* end of MRUBY_OPENAL_H */
 
@@ -5,22 +5,136 @@
 #include "mruby/string.h"
 #include "mruby/variable.h"
 #include <AL/al.h>
+#include <AL/alc.h>
 #include <AL/alut.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct RClass *mod_AL = NULL;
 
-static struct RClass *class_Buffers = NULL;
+struct RClass *class_Buffers = NULL;
 static struct RClass *class_Buffer = NULL;
-static struct RClass *class_Sources = NULL;
+struct RClass *class_Sources = NULL;
 static struct RClass *class_Source = NULL;
 static struct RClass *class_Listener = NULL;
-static struct RClass *class_ALError = NULL;
+struct RClass *class_ALError = NULL;
+
+typedef enum mrb_al_error_checking_t {
+  MRB_AL_ERROR_CHECKING_IMMEDIATE,
+  MRB_AL_ERROR_CHECKING_DEFERRED,
+  MRB_AL_ERROR_CHECKING_OFF
+} mrb_al_error_checking_t;
+
+static mrb_al_error_checking_t error_checking = MRB_AL_ERROR_CHECKING_IMMEDIATE;
+
+/* first error consumed by a call site in :deferred mode, reported by AL.check!. */
+static ALenum latched_error = AL_NO_ERROR;
+
+/* from AL_SOFT_source_latency. the entry point is looked up at run time. */
+#ifndef AL_SEC_OFFSET_LATENCY_SOFT
+#define AL_SEC_OFFSET_LATENCY_SOFT 0x1201
+#endif
+
+typedef void (*mrb_al_get_source_dv_t)(ALuint source, ALenum param, ALdouble *values);
+
+static mrb_al_get_source_dv_t get_source_dv = NULL;
+static bool get_source_dv_resolved = false;
+
+/*
+ * every alGetError on the mruby thread goes through here.
+ * outside :immediate mode the first error is latched so that a call site
+ * which inspects errors of its own does not hide an earlier one from
+ * AL.check! and AL.get_error.
+ * such a call site calls this once before its operation as well, so that a
+ * pending error of an earlier call is not taken for its own.
+ */
+ALenum
+mrb_al_fetch_error(void)
+{
+  ALenum const e = alGetError();
+  if ((AL_NO_ERROR != e) && (MRB_AL_ERROR_CHECKING_IMMEDIATE != error_checking) && (AL_NO_ERROR == latched_error)) {
+    latched_error = e;
+  }
+  return e;
+}
+
+/* returns and clears the first error since the last check. */
+static ALenum
+mrb_al_take_error(void)
+{
+  ALenum const e = mrb_al_fetch_error();
+  ALenum const first = (AL_NO_ERROR != latched_error) ? latched_error : e;
+  latched_error = AL_NO_ERROR;
+  return first;
+}
+
+/*
+ * raises ALError for a pending AL error in :immediate mode.
+ * other modes leave the error to AL, which keeps the first one recorded
+ * until AL.check! is called.
+ */
+void
+mrb_al_check_error(mrb_state *mrb)
+{
+  if (MRB_AL_ERROR_CHECKING_IMMEDIATE == error_checking) {
+    ALenum const e = mrb_al_fetch_error();
+    if (AL_NO_ERROR != e) {
+      mrb_raise(mrb, class_ALError, alGetString(e));
+    }
+  }
+}
+
+static mrb_value
+mrb_al_check(mrb_state *mrb, mrb_value self)
+{
+  if (MRB_AL_ERROR_CHECKING_OFF != error_checking) {
+    ALenum const e = mrb_al_take_error();
+    if (AL_NO_ERROR != e) {
+      mrb_raise(mrb, class_ALError, alGetString(e));
+    }
+  }
+  return mrb_nil_value();
+}
+
+static mrb_value
+mrb_al_get_error_checking(mrb_state *mrb, mrb_value self)
+{
+  switch (error_checking) {
+  case MRB_AL_ERROR_CHECKING_DEFERRED:
+    return mrb_symbol_value(mrb_intern(mrb, "deferred", 8));
+  case MRB_AL_ERROR_CHECKING_OFF:
+    return mrb_symbol_value(mrb_intern(mrb, "off", 3));
+  default:
+    return mrb_symbol_value(mrb_intern(mrb, "immediate", 9));
+  }
+}
+
+static mrb_value
+mrb_al_set_error_checking(mrb_state *mrb, mrb_value self)
+{
+  mrb_sym mode;
+  mrb_get_args(mrb, "n", &mode);
+  if (mode == mrb_intern(mrb, "immediate", 9)) {
+    error_checking = MRB_AL_ERROR_CHECKING_IMMEDIATE;
+  } else if (mode == mrb_intern(mrb, "deferred", 8)) {
+    error_checking = MRB_AL_ERROR_CHECKING_DEFERRED;
+  } else if (mode == mrb_intern(mrb, "off", 3)) {
+    error_checking = MRB_AL_ERROR_CHECKING_OFF;
+  } else {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "error checking mode must be :immediate, :deferred or :off.");
+  }
+  return mrb_symbol_value(mode);
+}
 
 static mrb_value
 mrb_al_get_error(mrb_state *mrb, mrb_value self)
 {
-  return mrb_fixnum_value(alGetError());
+  return mrb_fixnum_value(mrb_al_take_error());
 }
 
 static mrb_value
@@ -36,8 +150,9 @@ mrb_al_enable(mrb_state *mrb, mrb_value self)
 {
   mrb_int capability;
   mrb_get_args(mrb, "i", &capability);
+  mrb_al_fetch_error();
   alEnable(capability);
-  return alGetError() != AL_NO_ERROR ? mrb_false_value() : mrb_true_value();
+  return mrb_al_fetch_error() != AL_NO_ERROR ? mrb_false_value() : mrb_true_value();
 }
 
 static mrb_value
@@ -45,8 +160,9 @@ mrb_al_disable(mrb_state *mrb, mrb_value self)
 {
   mrb_int capability;
   mrb_get_args(mrb, "i", &capability);
+  mrb_al_fetch_error();
   alDisable(capability);
-  return alGetError() != AL_NO_ERROR ? mrb_false_value() : mrb_true_value();
+  return mrb_al_fetch_error() != AL_NO_ERROR ? mrb_false_value() : mrb_true_value();
 }
 
 static mrb_value
@@ -86,8 +202,9 @@ mrb_al_doppler_factor(mrb_state *mrb, mrb_value self)
 {
   mrb_float value;
   mrb_get_args(mrb, "f", &value);
+  mrb_al_fetch_error();
   alDopplerFactor((ALfloat)value);
-  return alGetError() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
+  return mrb_al_fetch_error() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
 }
 
 static mrb_value
@@ -95,8 +212,9 @@ mrb_al_doppler_velocity(mrb_state *mrb, mrb_value self)
 {
   mrb_float value;
   mrb_get_args(mrb, "f", &value);
+  mrb_al_fetch_error();
   alDopplerVelocity((ALfloat)value);
-  return alGetError() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
+  return mrb_al_fetch_error() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
 }
 
 static mrb_value
@@ -104,8 +222,9 @@ mrb_al_speed_of_sound(mrb_state *mrb, mrb_value self)
 {
   mrb_float value;
   mrb_get_args(mrb, "f", &value);
+  mrb_al_fetch_error();
   alSpeedOfSound((ALfloat)value);
-  return alGetError() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
+  return mrb_al_fetch_error() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
 }
 
 static mrb_value
@@ -113,25 +232,16 @@ mrb_al_distance_model(mrb_state *mrb, mrb_value self)
 {
   mrb_int value;
   mrb_get_args(mrb, "i", &value);
+  mrb_al_fetch_error();
   alDistanceModel((ALenum)value);
-  return alGetError() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
+  return mrb_al_fetch_error() == AL_NO_ERROR ? mrb_true_value() : mrb_false_value();
 }
 
-typedef struct mrb_al_buffers_data_t {
-  ALsizei size;
-  ALuint *buffers;
-} mrb_al_buffers_data_t;
-
 typedef struct mrb_al_buffer_data_t {
   bool   do_delete_on_free;
   ALuint buffer;
 } mrb_al_buffer_data_t;
 
-typedef struct mrb_al_sources_data_t {
-  ALsizei size;
-  ALuint *sources;
-} mrb_al_sources_data_t;
-
 typedef struct mrb_al_source_data_t {
   bool   do_delete_on_free;
   ALuint source;
@@ -183,9 +293,9 @@ mrb_al_source_free(mrb_state *mrb, void *p)
   }
 }
 
-static struct mrb_data_type const mrb_al_buffers_data_type = { "Buffers", mrb_al_buffers_free };
+struct mrb_data_type const mrb_al_buffers_data_type = { "Buffers", mrb_al_buffers_free };
 static struct mrb_data_type const mrb_al_buffer_data_type  = { "Buffer",  mrb_al_buffer_free };
-static struct mrb_data_type const mrb_al_sources_data_type = { "Sources", mrb_al_sources_free };
+struct mrb_data_type const mrb_al_sources_data_type = { "Sources", mrb_al_sources_free };
 static struct mrb_data_type const mrb_al_source_data_type  = { "Source",  mrb_al_source_free };
 
 static mrb_value
@@ -213,13 +323,15 @@ mrb_al_buffers_initialize(mrb_state *mrb, mrb_value self)
 
   DATA_PTR(self)  = data;
   DATA_TYPE(self) = &mrb_al_buffers_data_type;
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@buffers", 8), mrb_nil_value());
 
   if (NULL == data->buffers) {
     mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
   }
 
+  mrb_al_fetch_error();
   alGenBuffers(data->size, data->buffers);
-  ALenum const e = alGetError();
+  ALenum const e = mrb_al_fetch_error();
   if (AL_NO_ERROR != e) {
     mrb_raise(mrb, class_ALError, alGetString(e));
   }
@@ -227,6 +339,39 @@ mrb_al_buffers_initialize(mrb_state *mrb, mrb_value self)
   return self;
 }
 
+static mrb_value
+mrb_al_buffer_wrap(mrb_state *mrb, ALuint buffer)
+{
+  mrb_al_buffer_data_t *buf = (mrb_al_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_buffer_data_t));
+  if (NULL == buf) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  buf->do_delete_on_free = false;
+  buf->buffer = buffer;
+  return mrb_obj_value(Data_Wrap_Struct(mrb, class_Buffer, &mrb_al_buffer_data_type, buf));
+}
+
+/*
+ * wrappers of the elements are created on first access and cached in
+ * '@buffers', so that iteration does not allocate.
+ */
+static mrb_value
+mrb_al_buffers_child(mrb_state *mrb, mrb_value self, mrb_al_buffers_data_t *data, ALsizei index)
+{
+  mrb_sym const name = mrb_intern(mrb, "@buffers", 8);
+  mrb_value cache = mrb_iv_get(mrb, self, name);
+  if (mrb_nil_p(cache)) {
+    cache = mrb_ary_new_capa(mrb, data->size);
+    mrb_iv_set(mrb, self, name, cache);
+  }
+  mrb_value child = mrb_ary_ref(mrb, cache, index);
+  if (mrb_nil_p(child)) {
+    child = mrb_al_buffer_wrap(mrb, data->buffers[index]);
+    mrb_ary_set(mrb, cache, index, child);
+  }
+  return child;
+}
+
 static mrb_value
 mrb_al_buffers_each(mrb_state *mrb, mrb_value self)
 {
@@ -237,18 +382,8 @@ mrb_al_buffers_each(mrb_state *mrb, mrb_value self)
 
   ALsizei const size = data->size;
   ALsizei i;
-  mrb_al_buffer_data_t *buf;
   for (i = 0; i < size; ++i) {
-    buf = (mrb_al_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_buffer_data_t));
-    if (NULL == buf) {
-      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
-    }
-    buf->do_delete_on_free = false;
-    buf->buffer = data->buffers[i];
-    mrb_yield(
-      mrb,
-      block,
-      mrb_obj_value(Data_Wrap_Struct(mrb, class_Buffer, &mrb_al_buffer_data_type, buf)));
+    mrb_yield(mrb, block, mrb_al_buffers_child(mrb, self, data, i));
   }
   return self;
 }
@@ -269,17 +404,11 @@ mrb_al_buffers_get_at(mrb_state *mrb, mrb_value self)
   mrb_int index;
   mrb_get_args(mrb, "i", &index);
 
-  if ((index < 0) || (index > (mrb_int)data->size)) {
+  if ((index < 0) || (index >= (mrb_int)data->size)) {
     mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffers.");
   }
 
-  mrb_al_buffer_data_t *buf = mrb_malloc(mrb, sizeof(mrb_al_buffer_data_t));
-  if (NULL == buf) {
-    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
-  }
-  buf->do_delete_on_free = false;
-  buf->buffer = data->buffers[index];
-  return mrb_obj_value(Data_Wrap_Struct(mrb, class_Buffer, &mrb_al_buffer_data_type, buf));
+  return mrb_al_buffers_child(mrb, self, data, (ALsizei)index);
 }
 
 static mrb_value
@@ -301,8 +430,9 @@ mrb_al_buffer_initialize(mrb_state *mrb, mrb_value self)
   DATA_PTR(self) = data;
   DATA_TYPE(self) = &mrb_al_buffer_data_type;
 
+  mrb_al_fetch_error();
   alGenBuffers(1, &data->buffer);
-  ALenum const e = alGetError();
+  ALenum const e = mrb_al_fetch_error();
   if (AL_NO_ERROR != e) {
     mrb_raise(mrb, class_ALError, alGetString(e));
   }
@@ -315,12 +445,9 @@ mrb_al_buffer_get_xxx(mrb_state *mrb, mrb_value *self, ALenum param)
 {
   mrb_al_buffer_data_t *data =
     (mrb_al_buffer_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_buffer_data_type);
-  ALint value;
+  ALint value = 0;
   alGetBufferi(data->buffer, param, &value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
   return mrb_fixnum_value(value);
 }
 
@@ -348,6 +475,44 @@ mrb_al_buffer_get_bits(mrb_state *mrb, mrb_value self)
   return mrb_al_buffer_get_xxx(mrb, &self, AL_BITS);
 }
 
+static void
+mrb_al_buffer_data(mrb_state *mrb, mrb_value *self, mrb_value samples, mrb_int format, mrb_int frequency)
+{
+  mrb_al_buffer_data_t *data =
+    (mrb_al_buffer_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_buffer_data_type);
+  mrb_al_sample_buffer_data_t *samples_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, samples, &mrb_al_sample_buffer_data_type);
+  alBufferData(data->buffer, (ALenum)format, samples_data->buffer, (ALsizei)samples_data->size, (ALsizei)frequency);
+  mrb_al_check_error(mrb);
+}
+
+static mrb_value
+mrb_al_buffer_upload(mrb_state *mrb, mrb_value self)
+{
+  mrb_value samples;
+  mrb_int format, frequency;
+  mrb_get_args(mrb, "oii", &samples, &format, &frequency);
+  mrb_al_buffer_data(mrb, &self, samples, format, frequency);
+  return self;
+}
+
+static mrb_value
+mrb_al_buffer_set_data(mrb_state *mrb, mrb_value self)
+{
+  mrb_value args;
+  mrb_get_args(mrb, "A", &args);
+  if (RARRAY_LEN(args) != 3) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "sample buffer, format and frequency are required.");
+  }
+  mrb_value const format = RARRAY_PTR(args)[1];
+  mrb_value const frequency = RARRAY_PTR(args)[2];
+  if (!mrb_fixnum_p(format) || !mrb_fixnum_p(frequency)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "format and frequency must be integer type.");
+  }
+  mrb_al_buffer_data(mrb, &self, RARRAY_PTR(args)[0], mrb_fixnum(format), mrb_fixnum(frequency));
+  return args;
+}
+
 static mrb_value
 mrb_al_buffer_create_hello_world(mrb_state *mrb, mrb_value self)
 {
@@ -386,6 +551,81 @@ mrb_al_buffer_create_from_file(mrb_state *mrb, mrb_value self)
   return mrb_obj_value(Data_Wrap_Struct(mrb, class_Buffer, &mrb_al_buffer_data_type, buf));
 }
 
+/*
+ * maps the file and uploads straight from the mapping, so neither ALUT
+ * nor this extension keeps a heap copy of the samples.
+ * a file without RIFF header is taken as raw PCM of the given format.
+ */
+static mrb_value
+mrb_al_buffer_create_from_file_mmap(mrb_state *mrb, mrb_value self)
+{
+  mrb_value file;
+  mrb_int raw_format = 0;
+  mrb_int raw_frequency = 0;
+  int const argc = mrb_get_args(mrb, "S|ii", &file, &raw_format, &raw_frequency);
+  if (2 == argc) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "frequency is required for raw PCM.");
+  }
+
+  int const fd = open(RSTRING_PTR(file), O_RDONLY);
+  if (fd < 0) {
+    mrb_raisef(mrb, class_ALError, "cannot open file (%S).", file);
+  }
+  struct stat st;
+  if ((0 != fstat(fd, &st)) || (0 == st.st_size)) {
+    close(fd);
+    mrb_raisef(mrb, class_ALError, "cannot read file (%S).", file);
+  }
+  size_t const size = (size_t)st.st_size;
+  void *image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == image) {
+    mrb_raisef(mrb, class_ALError, "cannot map file (%S).", file);
+  }
+  madvise(image, size, MADV_SEQUENTIAL);
+
+  ALenum format = (ALenum)raw_format;
+  ALsizei frequency = (ALsizei)raw_frequency;
+  unsigned char const *pcm = (unsigned char const*)image;
+  size_t pcm_size = size;
+  char const *error = NULL;
+  if ((size >= 4) && (0 == memcmp(image, "RIFF", 4))) {
+    error = mrb_al_parse_wave((unsigned char const*)image, size, &format, &frequency, &pcm, &pcm_size);
+  } else if (argc < 3) {
+    error = "format and frequency are required for raw PCM.";
+  }
+  /* alBufferData takes an ALsizei, which would silently truncate the rest. */
+  if ((NULL == error) && (pcm_size > (size_t)INT_MAX)) {
+    error = "PCM data is too large for a buffer.";
+  }
+  if (NULL != error) {
+    munmap(image, size);
+    mrb_raise(mrb, class_ALError, error);
+  }
+
+  mrb_al_buffer_data_t *buf = (mrb_al_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_buffer_data_t));
+  if (NULL == buf) {
+    munmap(image, size);
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  buf->do_delete_on_free = true;
+  buf->buffer = 0;
+  mrb_value const buffer = mrb_obj_value(Data_Wrap_Struct(mrb, class_Buffer, &mrb_al_buffer_data_type, buf));
+
+  mrb_al_fetch_error();
+  alGenBuffers(1, &buf->buffer);
+  ALenum e = mrb_al_fetch_error();
+  if (AL_NO_ERROR == e) {
+    alBufferData(buf->buffer, format, pcm, (ALsizei)pcm_size, frequency);
+    e = mrb_al_fetch_error();
+  }
+  munmap(image, size);
+  if (AL_NO_ERROR != e) {
+    mrb_raise(mrb, class_ALError, alGetString(e));
+  }
+  return buffer;
+}
+
 static mrb_value
 mrb_al_buffer_create_waveform(mrb_state *mrb, mrb_value self)
 {
@@ -434,13 +674,15 @@ mrb_al_sources_initialize(mrb_state *mrb, mrb_value self)
 
   DATA_PTR(self)  = data;
   DATA_TYPE(self) = &mrb_al_sources_data_type;
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@sources", 8), mrb_nil_value());
 
   if (NULL == data->sources) {
     mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
   }
 
+  mrb_al_fetch_error();
   alGenSources(data->size, data->sources);
-  ALenum const e = alGetError();
+  ALenum const e = mrb_al_fetch_error();
   if (AL_NO_ERROR != e) {
     mrb_raise(mrb, class_ALError, alGetString(e));
   }
@@ -448,6 +690,55 @@ mrb_al_sources_initialize(mrb_state *mrb, mrb_value self)
   return self;
 }
 
+mrb_value
+mrb_al_source_wrap(mrb_state *mrb, ALuint source)
+{
+  mrb_al_source_data_t *src = (mrb_al_source_data_t*)mrb_malloc(mrb, sizeof(mrb_al_source_data_t));
+  if (NULL == src) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  src->do_delete_on_free = false;
+  src->source = source;
+  return mrb_obj_value(Data_Wrap_Struct(mrb, class_Source, &mrb_al_source_data_type, src));
+}
+
+ALuint
+mrb_al_source_name(mrb_state *mrb, mrb_value source)
+{
+  mrb_al_source_data_t *data =
+    (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, source, &mrb_al_source_data_type);
+  return data->source;
+}
+
+/*
+ * wrappers of the elements are created on first access and cached in
+ * '@sources', so that iteration does not allocate.
+ */
+static mrb_value
+mrb_al_sources_child(mrb_state *mrb, mrb_value self, mrb_al_sources_data_t *data, ALsizei index)
+{
+  mrb_sym const name = mrb_intern(mrb, "@sources", 8);
+  mrb_value cache = mrb_iv_get(mrb, self, name);
+  if (mrb_nil_p(cache)) {
+    cache = mrb_ary_new_capa(mrb, data->size);
+    mrb_iv_set(mrb, self, name, cache);
+  }
+  mrb_value child = mrb_ary_ref(mrb, cache, index);
+  if (mrb_nil_p(child)) {
+    child = mrb_al_source_wrap(mrb, data->sources[index]);
+    mrb_ary_set(mrb, cache, index, child);
+  }
+  return child;
+}
+
+mrb_value
+mrb_al_sources_at(mrb_state *mrb, mrb_value self, ALsizei index)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  return mrb_al_sources_child(mrb, self, data, index);
+}
+
 static mrb_value
 mrb_al_sources_each(mrb_state *mrb, mrb_value self)
 {
@@ -458,18 +749,8 @@ mrb_al_sources_each(mrb_state *mrb, mrb_value self)
 
   ALsizei const size = data->size;
   ALsizei i;
-  mrb_al_source_data_t *src;
   for (i = 0; i < size; ++i) {
-    src = (mrb_al_source_data_t*)mrb_malloc(mrb, sizeof(mrb_al_source_data_t));
-    if (NULL == src) {
-      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
-    }
-    src->do_delete_on_free = false;
-    src->source = data->sources[i];
-    mrb_yield(
-      mrb,
-      block,
-      mrb_obj_value(Data_Wrap_Struct(mrb, class_Source, &mrb_al_source_data_type, src)));
+    mrb_yield(mrb, block, mrb_al_sources_child(mrb, self, data, i));
   }
   return self;
 }
@@ -490,17 +771,259 @@ mrb_al_sources_get_at(mrb_state *mrb, mrb_value self)
   mrb_int index;
   mrb_get_args(mrb, "i", &index);
 
-  if ((index < 0) || (index > (mrb_int)data->size)) {
-    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffers.");
+  if ((index < 0) || (index >= (mrb_int)data->size)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of sources.");
   }
 
-  mrb_al_source_data_t *buf = mrb_malloc(mrb, sizeof(mrb_al_source_data_t));
-  if (NULL == buf) {
-    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  return mrb_al_sources_child(mrb, self, data, (ALsizei)index);
+}
+
+/*
+ * resolves the optional (range) or (offset[, count]) arguments of the
+ * Sources batch operations into a sub-range of the source names.
+ */
+static void
+mrb_al_sources_get_range(mrb_state *mrb, mrb_al_sources_data_t *data, ALsizei *offset, ALsizei *count)
+{
+  mrb_value arg = mrb_nil_value();
+  mrb_int length = 0;
+  int const argc = mrb_get_args(mrb, "|oi", &arg, &length);
+  mrb_int begin = 0;
+  mrb_int end = data->size;
+  if (0 < argc) {
+    if (mrb_fixnum_p(arg)) {
+      begin = mrb_fixnum(arg);
+      if (1 < argc) {
+        end = begin + length;
+      }
+    } else if (mrb_respond_to(mrb, arg, mrb_intern(mrb, "exclude_end?", 12))) {
+      mrb_value const first = mrb_funcall(mrb, arg, "first", 0);
+      mrb_value const last = mrb_funcall(mrb, arg, "last", 0);
+      if (!mrb_fixnum_p(first) || !mrb_fixnum_p(last)) {
+        mrb_raise(mrb, E_TYPE_ERROR, "range must consist of integers.");
+      }
+      begin = mrb_fixnum(first);
+      end = mrb_fixnum(last);
+      if (!mrb_test(mrb_funcall(mrb, arg, "exclude_end?", 0))) {
+        ++end;
+      }
+    } else {
+      mrb_raise(mrb, E_TYPE_ERROR, "given argument is not an index or a range.");
+    }
+  }
+  if ((begin < 0) || (end < begin) || ((mrb_int)data->size < end)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of sources.");
+  }
+  *offset = (ALsizei)begin;
+  *count = (ALsizei)(end - begin);
+}
+
+static mrb_value
+mrb_al_sources_play(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  ALsizei offset, count;
+  mrb_al_sources_get_range(mrb, data, &offset, &count);
+  alSourcePlayv(count, &data->sources[offset]);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_sources_stop(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  ALsizei offset, count;
+  mrb_al_sources_get_range(mrb, data, &offset, &count);
+  alSourceStopv(count, &data->sources[offset]);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_sources_pause(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  ALsizei offset, count;
+  mrb_al_sources_get_range(mrb, data, &offset, &count);
+  alSourcePausev(count, &data->sources[offset]);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_sources_rewind(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  ALsizei offset, count;
+  mrb_al_sources_get_range(mrb, data, &offset, &count);
+  alSourceRewindv(count, &data->sources[offset]);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static ALsizei
+mrb_al_source_param_components(ALenum param)
+{
+  switch (param) {
+  case AL_POSITION:
+  case AL_VELOCITY:
+  case AL_DIRECTION:
+    return 3;
+  case AL_GAIN:
+  case AL_PITCH:
+  case AL_MIN_GAIN:
+  case AL_MAX_GAIN:
+  case AL_REFERENCE_DISTANCE:
+  case AL_ROLLOFF_FACTOR:
+  case AL_MAX_DISTANCE:
+  case AL_CONE_INNER_ANGLE:
+  case AL_CONE_OUTER_ANGLE:
+  case AL_CONE_OUTER_GAIN:
+    return 1;
+  default:
+    return 0;
   }
-  buf->do_delete_on_free = false;
-  buf->source = data->sources[index];
-  return mrb_obj_value(Data_Wrap_Struct(mrb, class_Source, &mrb_al_source_data_type, buf));
+}
+
+static ALfloat
+mrb_al_value_to_float(mrb_state *mrb, mrb_value value)
+{
+  if (mrb_float_p(value)) {
+    return (ALfloat)mrb_float(value);
+  }
+  if (mrb_fixnum_p(value)) {
+    return (ALfloat)mrb_fixnum(value);
+  }
+  mrb_raise(mrb, E_TYPE_ERROR, "values must be numeric type.");
+  return 0.0f;
+}
+
+/*
+ * reads 'count' floats from a flat Array or a SampleBuffer of packed
+ * 32-bit floats, starting at component 'offset'.
+ */
+static void
+mrb_al_read_floats(mrb_state *mrb, mrb_value values, ALfloat *dst, mrb_int offset, mrb_int count)
+{
+  mrb_int i;
+  if (mrb_array_p(values)) {
+    if (RARRAY_LEN(values) < offset + count) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "too few values are supplied.");
+    }
+    mrb_value const *ptr = RARRAY_PTR(values) + offset;
+    for (i = 0; i < count; ++i) {
+      dst[i] = mrb_al_value_to_float(mrb, ptr[i]);
+    }
+  } else {
+    mrb_al_sample_buffer_data_t *samples_data =
+      (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, values, &mrb_al_sample_buffer_data_type);
+    if (samples_data->size < sizeof(ALfloat) * (offset + count)) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "too few values are supplied.");
+    }
+    memcpy(dst, (ALfloat const*)samples_data->buffer + offset, sizeof(ALfloat) * count);
+  }
+}
+
+/*
+ * stores 'count' floats into 'dst' at component 'offset' and returns it.
+ * 'dst' may be nil for a new Array, an Array to overwrite, or a SampleBuffer
+ * taking packed 32-bit floats, which allocates nothing.
+ */
+static mrb_value
+mrb_al_write_floats(mrb_state *mrb, mrb_value dst, ALfloat const *values, mrb_int offset, mrb_int count)
+{
+  mrb_int i;
+  if (offset < 0) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  if (mrb_nil_p(dst)) {
+    dst = mrb_ary_new_capa(mrb, offset + count);
+  }
+  if (mrb_array_p(dst)) {
+    for (i = 0; i < count; ++i) {
+      mrb_ary_set(mrb, dst, offset + i, mrb_float_value(mrb, values[i]));
+    }
+    return dst;
+  }
+  mrb_al_sample_buffer_data_t *samples_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, dst, &mrb_al_sample_buffer_data_type);
+  size_t const end = sizeof(ALfloat) * (offset + count);
+  if (samples_data->capacity < end) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  memcpy((ALfloat*)samples_data->buffer + offset, values, sizeof(ALfloat) * count);
+  if (samples_data->size < end) {
+    samples_data->size = end;
+  }
+  return dst;
+}
+
+/*
+ * applies one float parameter to every source in a single call.
+ * 'values' is a flat Array or a SampleBuffer of packed 32-bit floats,
+ * holding 1 or 3 components per source.
+ */
+static mrb_value
+mrb_al_sources_update(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sources_data_t *data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sources_data_type);
+  mrb_int param;
+  mrb_value values;
+  mrb_get_args(mrb, "io", &param, &values);
+
+  ALsizei const components = mrb_al_source_param_components((ALenum)param);
+  if (0 == components) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "unsupported source parameter.");
+  }
+  ALsizei const size = data->size;
+  ALsizei const count = size * components;
+  ALsizei i;
+
+  if (mrb_array_p(values)) {
+    if (RARRAY_LEN(values) < count) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "too few values are supplied.");
+    }
+    mrb_value const *ptr = RARRAY_PTR(values);
+    if (3 == components) {
+      for (i = 0; i < size; ++i) {
+        alSource3f(
+          data->sources[i],
+          (ALenum)param,
+          mrb_al_value_to_float(mrb, ptr[i * 3 + 0]),
+          mrb_al_value_to_float(mrb, ptr[i * 3 + 1]),
+          mrb_al_value_to_float(mrb, ptr[i * 3 + 2]));
+      }
+    } else {
+      for (i = 0; i < size; ++i) {
+        alSourcef(data->sources[i], (ALenum)param, mrb_al_value_to_float(mrb, ptr[i]));
+      }
+    }
+  } else {
+    mrb_al_sample_buffer_data_t *samples_data =
+      (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, values, &mrb_al_sample_buffer_data_type);
+    if (samples_data->size < sizeof(ALfloat) * count) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "too few values are supplied.");
+    }
+    ALfloat const *ptr = (ALfloat const*)samples_data->buffer;
+    if (3 == components) {
+      for (i = 0; i < size; ++i) {
+        alSourcefv(data->sources[i], (ALenum)param, &ptr[i * 3]);
+      }
+    } else {
+      for (i = 0; i < size; ++i) {
+        alSourcef(data->sources[i], (ALenum)param, ptr[i]);
+      }
+    }
+  }
+
+  mrb_al_check_error(mrb);
+  return self;
 }
 
 static mrb_value
@@ -522,8 +1045,9 @@ mrb_al_source_initialize(mrb_state *mrb, mrb_value self)
   DATA_PTR(self) = data;
   DATA_TYPE(self) = &mrb_al_source_data_type;
 
+  mrb_al_fetch_error();
   alGenSources(1, &data->source);
-  ALenum const e = alGetError();
+  ALenum const e = mrb_al_fetch_error();
   if (AL_NO_ERROR != e) {
     mrb_raise(mrb, class_ALError, alGetString(e));
   }
@@ -536,12 +1060,9 @@ mrb_al_source_get_xxx_i(mrb_state *mrb, mrb_value *self, ALenum param)
 {
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
-  ALint value;
+  ALint value = 0;
   alGetSourcei(data->source, param, &value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
   return mrb_fixnum_value(value);
 }
 
@@ -551,10 +1072,7 @@ mrb_al_source_set_xxx_i(mrb_state *mrb, mrb_value *self, ALenum param, mrb_int v
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
   alSourcei(data->source, param, (ALint)value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
 }
 
 static mrb_value
@@ -562,12 +1080,9 @@ mrb_al_source_get_xxx_b(mrb_state *mrb, mrb_value *self, ALenum param)
 {
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
-  ALint value;
+  ALint value = 0;
   alGetSourcei(data->source, param, &value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
   return (value == AL_FALSE) ? mrb_false_value() : mrb_true_value();
 }
 
@@ -577,10 +1092,7 @@ mrb_al_source_set_xxx_b(mrb_state *mrb, mrb_value *self, ALenum param, mrb_bool
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
   alSourcei(data->source, param, value ? AL_TRUE : AL_FALSE);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
 }
 
 static mrb_value
@@ -588,12 +1100,9 @@ mrb_al_source_get_xxx_f(mrb_state *mrb, mrb_value *self, ALenum param)
 {
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
-  ALfloat value;
+  ALfloat value = 0.0f;
   alGetSourcef(data->source, param, &value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
   return mrb_float_value(mrb, value);
 }
 
@@ -603,29 +1112,65 @@ mrb_al_source_set_xxx_f(mrb_state *mrb, mrb_value *self, ALenum param, mrb_float
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
   alSourcef(data->source, param, (ALfloat)value);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
 }
 
+/* takes an optional destination and component index, see mrb_al_write_floats. */
 static mrb_value
 mrb_al_source_get_xxx_3f(mrb_state *mrb, mrb_value *self, ALenum param)
 {
   mrb_al_source_data_t *data =
     (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
+  mrb_value dst = mrb_nil_value();
+  mrb_int index = 0;
+  mrb_get_args(mrb, "|oi", &dst, &index);
   ALfloat values[3] = { 0.0f, 0.0f, 0.0f };
   alGetSourcefv(data->source, param, values);
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
+  mrb_al_check_error(mrb);
+  return mrb_al_write_floats(mrb, dst, values, index, 3);
+}
+
+static mrb_value
+mrb_al_source_set_xxx_3f(mrb_state *mrb, mrb_value *self, ALenum param)
+{
+  mrb_al_source_data_t *data =
+    (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
+  mrb_value value;
+  mrb_get_args(mrb, "o", &value);
+  ALfloat values[3];
+  mrb_al_read_floats(mrb, value, values, 0, 3);
+  alSourcefv(data->source, param, values);
+  mrb_al_check_error(mrb);
+  return value;
+}
+
+/*
+ * set_xxx(x, y, z) or set_xxx(values[, index]), where 'values' is an
+ * Array or a SampleBuffer of packed floats read from component 'index'.
+ */
+static mrb_value
+mrb_al_source_set_xxx_3f_at(mrb_state *mrb, mrb_value *self, ALenum param)
+{
+  mrb_al_source_data_t *data =
+    (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, *self, &mrb_al_source_data_type);
+  mrb_value x, y, z;
+  int const argc = mrb_get_args(mrb, "o|oo", &x, &y, &z);
+  ALfloat values[3];
+  if (3 == argc) {
+    values[0] = mrb_al_value_to_float(mrb, x);
+    values[1] = mrb_al_value_to_float(mrb, y);
+    values[2] = mrb_al_value_to_float(mrb, z);
+  } else if (1 == argc) {
+    mrb_al_read_floats(mrb, x, values, 0, 3);
+  } else {
+    if (!mrb_fixnum_p(y) || (mrb_fixnum(y) < 0)) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "index must be a non-negative integer.");
+    }
+    mrb_al_read_floats(mrb, x, values, mrb_fixnum(y), 3);
   }
-  mrb_value array_values[3] = {
-    mrb_float_value(mrb, values[0]),
-    mrb_float_value(mrb, values[1]),
-    mrb_float_value(mrb, values[2])
-  };
-  return mrb_ary_new_from_values(mrb, 3, array_values);
+  alSource3f(data->source, param, values[0], values[1], values[2]);
+  mrb_al_check_error(mrb);
+  return *self;
 }
 
 static mrb_value
@@ -694,10 +1239,7 @@ mrb_al_source_set_buffer(mrb_state *mrb, mrb_value self)
       (mrb_al_buffer_data_t*)mrb_data_get_ptr(mrb, buffer, &mrb_al_buffer_data_type);
     alSourcei(data->source, AL_BUFFER, buf_data->buffer);
   }
-  ALenum const e = alGetError();
-  if (AL_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALError, alGetString(e));
-  }
+  mrb_al_check_error(mrb);
   return buffer;
 }
 
@@ -803,12 +1345,60 @@ mrb_al_source_set_pitch(mrb_state *mrb, mrb_value self)
   return self; 
 }
 
+static mrb_value
+mrb_al_source_get_position(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_get_xxx_3f(mrb, &self, AL_POSITION);
+}
+
+static mrb_value
+mrb_al_source_set_position(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f(mrb, &self, AL_POSITION);
+}
+
+static mrb_value
+mrb_al_source_set_position_at(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f_at(mrb, &self, AL_POSITION);
+}
+
+static mrb_value
+mrb_al_source_get_velocity(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_get_xxx_3f(mrb, &self, AL_VELOCITY);
+}
+
+static mrb_value
+mrb_al_source_set_velocity(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f(mrb, &self, AL_VELOCITY);
+}
+
+static mrb_value
+mrb_al_source_set_velocity_at(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f_at(mrb, &self, AL_VELOCITY);
+}
+
 static mrb_value
 mrb_al_source_get_direction(mrb_state *mrb, mrb_value self)
 {
   return mrb_al_source_get_xxx_3f(mrb, &self, AL_DIRECTION);
 }
 
+static mrb_value
+mrb_al_source_set_direction(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f(mrb, &self, AL_DIRECTION);
+}
+
+static mrb_value
+mrb_al_source_set_direction_at(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_source_set_xxx_3f_at(mrb, &self, AL_DIRECTION);
+}
+
 static mrb_value
 mrb_al_source_get_cone_inner_angle(mrb_state *mrb, mrb_value self)
 {
@@ -833,16 +1423,88 @@ mrb_al_source_get_sec_offset(mrb_state *mrb, mrb_value self)
   return mrb_al_source_get_xxx_f(mrb, &self, AL_SEC_OFFSET);
 }
 
+static mrb_value
+mrb_al_source_set_sec_offset(mrb_state *mrb, mrb_value self)
+{
+  mrb_float value;
+  mrb_get_args(mrb, "f", &value);
+  mrb_al_source_set_xxx_f(mrb, &self, AL_SEC_OFFSET, value);
+  return mrb_float_value(mrb, value);
+}
+
 static mrb_value
 mrb_al_source_get_sample_offset(mrb_state *mrb, mrb_value self)
 {
-  return mrb_al_source_get_xxx_f(mrb, &self, AL_SAMPLE_OFFSET);
+  return mrb_al_source_get_xxx_i(mrb, &self, AL_SAMPLE_OFFSET);
+}
+
+static mrb_value
+mrb_al_source_set_sample_offset(mrb_state *mrb, mrb_value self)
+{
+  mrb_int value;
+  mrb_get_args(mrb, "i", &value);
+  mrb_al_source_set_xxx_i(mrb, &self, AL_SAMPLE_OFFSET, value);
+  return mrb_fixnum_value(value);
 }
 
 static mrb_value
 mrb_al_source_get_byte_offset(mrb_state *mrb, mrb_value self)
 {
-  return mrb_al_source_get_xxx_f(mrb, &self, AL_BYTE_OFFSET);
+  return mrb_al_source_get_xxx_i(mrb, &self, AL_BYTE_OFFSET);
+}
+
+static mrb_value
+mrb_al_source_set_byte_offset(mrb_state *mrb, mrb_value self)
+{
+  mrb_int value;
+  mrb_get_args(mrb, "i", &value);
+  mrb_al_source_set_xxx_i(mrb, &self, AL_BYTE_OFFSET, value);
+  return mrb_fixnum_value(value);
+}
+
+/*
+ * reads the playback position and the output latency, both in seconds,
+ * sampled together by AL_SOFT_source_latency.
+ * without the extension the latency is reported as 0 and false is returned.
+ */
+bool
+mrb_al_source_offset_latency(ALuint source, double *offset, double *latency)
+{
+  /* extension queries need a current context, so wait for one before caching the answer. */
+  if (!get_source_dv_resolved && (NULL != alcGetCurrentContext())) {
+    if (alIsExtensionPresent("AL_SOFT_source_latency")) {
+      get_source_dv = (mrb_al_get_source_dv_t)alGetProcAddress("alGetSourcedvSOFT");
+    }
+    get_source_dv_resolved = true;
+  }
+  if (NULL != get_source_dv) {
+    ALdouble values[2] = { 0.0, 0.0 };
+    get_source_dv(source, AL_SEC_OFFSET_LATENCY_SOFT, values);
+    *offset = values[0];
+    *latency = values[1];
+    return true;
+  }
+  ALfloat value = 0.0f;
+  alGetSourcef(source, AL_SEC_OFFSET, &value);
+  *offset = value;
+  *latency = 0.0;
+  return false;
+}
+
+/* returns [offset, latency] in seconds. */
+static mrb_value
+mrb_al_source_get_sec_offset_latency(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_data_t *data =
+    (mrb_al_source_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_data_type);
+  double offset, latency;
+  mrb_al_source_offset_latency(data->source, &offset, &latency);
+  mrb_al_check_error(mrb);
+  mrb_value values[2] = {
+    mrb_float_value(mrb, offset),
+    mrb_float_value(mrb, latency)
+  };
+  return mrb_ary_new_from_values(mrb, 2, values);
 }
 
 static mrb_value
@@ -927,10 +1589,7 @@ mrb_al_source_queue_buffers(mrb_state *mrb, mrb_value self)
   if (DATA_TYPE(arg) == &mrb_al_buffer_data_type) {
     mrb_al_buffer_data_t *bdata = (mrb_al_buffer_data_t*)DATA_PTR(arg);
     alSourceQueueBuffers(data->source, 1, &bdata->buffer);
-    ALenum const e = alGetError();
-    if (AL_NO_ERROR != e) {
-      mrb_raise(mrb, class_ALError, alGetString(e));
-    }
+    mrb_al_check_error(mrb);
   } else if (DATA_TYPE(arg) == &mrb_al_buffers_data_type) {
     mrb_al_buffers_data_t *bdata = (mrb_al_buffers_data_t*)DATA_PTR(arg);
     ALsizei size = bdata->size;
@@ -947,10 +1606,7 @@ mrb_al_source_queue_buffers(mrb_state *mrb, mrb_value self)
       size = count;
     }
     alSourceQueueBuffers(data->source, size, &bdata->buffers[offset]);
-    ALenum const e = alGetError();
-    if (AL_NO_ERROR != e) {
-      mrb_raise(mrb, class_ALError, alGetString(e));
-    }
+    mrb_al_check_error(mrb);
   } else {
     mrb_raise(mrb, E_TYPE_ERROR, "given argument is not a buffer.");
   }
@@ -971,8 +1627,9 @@ mrb_al_source_unqueue_buffers(mrb_state *mrb, mrb_value self)
   }
   if (DATA_TYPE(arg) == &mrb_al_buffer_data_type) {
     mrb_al_buffer_data_t *bdata = (mrb_al_buffer_data_t*)DATA_PTR(arg);
+    mrb_al_fetch_error();
     alSourceUnqueueBuffers(data->source, 1, &bdata->buffer);
-    ALenum const e = alGetError();
+    ALenum const e = mrb_al_fetch_error();
     if (AL_NO_ERROR != e) {
       mrb_raise(mrb, E_RUNTIME_ERROR, alGetString(e));
     }
@@ -992,16 +1649,121 @@ mrb_al_source_unqueue_buffers(mrb_state *mrb, mrb_value self)
       size = count;
     }
     alSourceUnqueueBuffers(data->source, size, &bdata->buffers[offset]);
-    ALenum const e = alGetError();
-    if (AL_NO_ERROR != e) {
-      mrb_raise(mrb, class_ALError, alGetString(e));
-    }
+    mrb_al_check_error(mrb);
   } else {
     mrb_raise(mrb, E_TYPE_ERROR, "given argument is not a buffer.");
   }
   return self;
 }
 
+static mrb_value
+mrb_al_listener_get_xxx_fv(mrb_state *mrb, ALenum param, mrb_int count)
+{
+  mrb_value dst = mrb_nil_value();
+  mrb_int index = 0;
+  mrb_get_args(mrb, "|oi", &dst, &index);
+  ALfloat values[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  alGetListenerfv(param, values);
+  mrb_al_check_error(mrb);
+  return mrb_al_write_floats(mrb, dst, values, index, count);
+}
+
+static mrb_value
+mrb_al_listener_set_xxx_fv(mrb_state *mrb, ALenum param, mrb_int count)
+{
+  mrb_value value;
+  mrb_get_args(mrb, "o", &value);
+  ALfloat values[6];
+  mrb_al_read_floats(mrb, value, values, 0, count);
+  alListenerfv(param, values);
+  mrb_al_check_error(mrb);
+  return value;
+}
+
+static mrb_value
+mrb_al_listener_get_position(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_get_xxx_fv(mrb, AL_POSITION, 3);
+}
+
+static mrb_value
+mrb_al_listener_set_position(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_set_xxx_fv(mrb, AL_POSITION, 3);
+}
+
+static mrb_value
+mrb_al_listener_get_velocity(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_get_xxx_fv(mrb, AL_VELOCITY, 3);
+}
+
+static mrb_value
+mrb_al_listener_set_velocity(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_set_xxx_fv(mrb, AL_VELOCITY, 3);
+}
+
+/* 'at' vector followed by 'up' vector. */
+static mrb_value
+mrb_al_listener_get_orientation(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_get_xxx_fv(mrb, AL_ORIENTATION, 6);
+}
+
+static mrb_value
+mrb_al_listener_set_orientation(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_listener_set_xxx_fv(mrb, AL_ORIENTATION, 6);
+}
+
+static mrb_value
+mrb_al_listener_get_gain(mrb_state *mrb, mrb_value self)
+{
+  ALfloat value = 0.0f;
+  alGetListenerf(AL_GAIN, &value);
+  mrb_al_check_error(mrb);
+  return mrb_float_value(mrb, value);
+}
+
+static mrb_value
+mrb_al_listener_set_gain(mrb_state *mrb, mrb_value self)
+{
+  mrb_float value;
+  mrb_get_args(mrb, "f", &value);
+  alListenerf(AL_GAIN, (ALfloat)value);
+  mrb_al_check_error(mrb);
+  return mrb_float_value(mrb, value);
+}
+
+/*
+ * moves the listener with three alListenerfv calls.
+ * takes (pos, vel, at, up) as four 3-component values, or a single flat
+ * Array or SampleBuffer holding the 12 floats in that order.
+ */
+static mrb_value
+mrb_al_listener_update(mrb_state *mrb, mrb_value self)
+{
+  mrb_value pos, vel, at, up;
+  int const argc = mrb_get_args(mrb, "o|ooo", &pos, &vel, &at, &up);
+  ALfloat values[12];
+  if (1 == argc) {
+    mrb_al_read_floats(mrb, pos, values, 0, 12);
+  } else if (4 == argc) {
+    mrb_al_read_floats(mrb, pos, &values[0], 0, 3);
+    mrb_al_read_floats(mrb, vel, &values[3], 0, 3);
+    mrb_al_read_floats(mrb, at,  &values[6], 0, 3);
+    mrb_al_read_floats(mrb, up,  &values[9], 0, 3);
+  } else {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "wrong number of arguments.");
+  }
+  alListenerfv(AL_POSITION, &values[0]);
+  alListenerfv(AL_VELOCITY, &values[3]);
+  alListenerfv(AL_ORIENTATION, &values[6]);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
 void
 mruby_openal_al_init(mrb_state *mrb)
 {
@@ -1020,6 +1782,9 @@ mruby_openal_al_init(mrb_state *mrb)
   MRB_SET_INSTANCE_TT(class_Listener, MRB_TT_DATA);
 
   mrb_define_module_function(mrb, mod_AL, "get_error",         mrb_al_get_error,        ARGS_NONE());
+  mrb_define_module_function(mrb, mod_AL, "check!",            mrb_al_check,            ARGS_NONE());
+  mrb_define_module_function(mrb, mod_AL, "error_checking",    mrb_al_get_error_checking, ARGS_NONE());
+  mrb_define_module_function(mrb, mod_AL, "error_checking=",   mrb_al_set_error_checking, ARGS_REQ(1));
   mrb_define_module_function(mrb, mod_AL, "enable",            mrb_al_enable,           ARGS_REQ(1));
   mrb_define_module_function(mrb, mod_AL, "disable",           mrb_al_disable,          ARGS_REQ(1));
   mrb_define_module_function(mrb, mod_AL, "eanbled?",          mrb_al_is_enabled,       ARGS_REQ(1));
@@ -1032,6 +1797,20 @@ mruby_openal_al_init(mrb_state *mrb)
   mrb_define_module_function(mrb, mod_AL, "speed_of_sound=",   mrb_al_speed_of_sound,   ARGS_REQ(1));
   mrb_define_module_function(mrb, mod_AL, "distance_model=",   mrb_al_distance_model,   ARGS_REQ(1));
 
+  mrb_define_const(mrb, mod_AL, "POSITION",           mrb_fixnum_value(AL_POSITION));
+  mrb_define_const(mrb, mod_AL, "VELOCITY",           mrb_fixnum_value(AL_VELOCITY));
+  mrb_define_const(mrb, mod_AL, "DIRECTION",          mrb_fixnum_value(AL_DIRECTION));
+  mrb_define_const(mrb, mod_AL, "GAIN",               mrb_fixnum_value(AL_GAIN));
+  mrb_define_const(mrb, mod_AL, "PITCH",              mrb_fixnum_value(AL_PITCH));
+  mrb_define_const(mrb, mod_AL, "MIN_GAIN",           mrb_fixnum_value(AL_MIN_GAIN));
+  mrb_define_const(mrb, mod_AL, "MAX_GAIN",           mrb_fixnum_value(AL_MAX_GAIN));
+  mrb_define_const(mrb, mod_AL, "REFERENCE_DISTANCE", mrb_fixnum_value(AL_REFERENCE_DISTANCE));
+  mrb_define_const(mrb, mod_AL, "ROLLOFF_FACTOR",     mrb_fixnum_value(AL_ROLLOFF_FACTOR));
+  mrb_define_const(mrb, mod_AL, "MAX_DISTANCE",       mrb_fixnum_value(AL_MAX_DISTANCE));
+  mrb_define_const(mrb, mod_AL, "CONE_INNER_ANGLE",   mrb_fixnum_value(AL_CONE_INNER_ANGLE));
+  mrb_define_const(mrb, mod_AL, "CONE_OUTER_ANGLE",   mrb_fixnum_value(AL_CONE_OUTER_ANGLE));
+  mrb_define_const(mrb, mod_AL, "CONE_OUTER_GAIN",    mrb_fixnum_value(AL_CONE_OUTER_GAIN));
+
   mrb_define_method(mrb, class_Buffers, "initialize", mrb_al_buffers_initialize, ARGS_REQ(1));
   mrb_define_method(mrb, class_Buffers, "each",       mrb_al_buffers_each,       ARGS_NONE());
   mrb_define_method(mrb, class_Buffers, "size",       mrb_al_buffers_size,       ARGS_NONE());
@@ -1042,14 +1821,22 @@ mruby_openal_al_init(mrb_state *mrb)
   mrb_define_method(mrb, class_Buffer, "frequency",  mrb_al_buffer_get_frequency, ARGS_NONE());
   mrb_define_method(mrb, class_Buffer, "channels",   mrb_al_buffer_get_channels,  ARGS_NONE());
   mrb_define_method(mrb, class_Buffer, "bits",       mrb_al_buffer_get_bits,      ARGS_NONE());
+  mrb_define_method(mrb, class_Buffer, "upload",     mrb_al_buffer_upload,        ARGS_REQ(3));
+  mrb_define_method(mrb, class_Buffer, "data=",      mrb_al_buffer_set_data,      ARGS_REQ(1));
   mrb_define_class_method(mrb, class_Buffer, "hello_world", mrb_al_buffer_create_hello_world, ARGS_NONE());
   mrb_define_class_method(mrb, class_Buffer, "from_file",   mrb_al_buffer_create_from_file,   ARGS_REQ(1));
+  mrb_define_class_method(mrb, class_Buffer, "from_file_mmap", mrb_al_buffer_create_from_file_mmap, ARGS_REQ(1) | ARGS_OPT(2));
   mrb_define_class_method(mrb, class_Buffer, "waveform",    mrb_al_buffer_create_waveform,    ARGS_REQ(4));
 
   mrb_define_method(mrb, class_Sources, "initialize", mrb_al_sources_initialize, ARGS_REQ(1));
   mrb_define_method(mrb, class_Sources, "each",       mrb_al_sources_each,       ARGS_NONE());
   mrb_define_method(mrb, class_Sources, "size",       mrb_al_sources_size,       ARGS_NONE());
   mrb_define_method(mrb, class_Sources, "[]",         mrb_al_sources_get_at,     ARGS_REQ(1));
+  mrb_define_method(mrb, class_Sources, "update",     mrb_al_sources_update,     ARGS_REQ(2));
+  mrb_define_method(mrb, class_Sources, "play",       mrb_al_sources_play,       ARGS_OPT(2));
+  mrb_define_method(mrb, class_Sources, "stop",       mrb_al_sources_stop,       ARGS_OPT(2));
+  mrb_define_method(mrb, class_Sources, "pause",      mrb_al_sources_pause,      ARGS_OPT(2));
+  mrb_define_method(mrb, class_Sources, "rewind",     mrb_al_sources_rewind,     ARGS_OPT(2));
 
   mrb_define_method(mrb, class_Source, "initialize",          mrb_al_source_initialize,             ARGS_NONE());
   mrb_define_method(mrb, class_Source, "relative?",           mrb_al_source_is_relative,            ARGS_NONE());
@@ -1074,13 +1861,25 @@ mruby_openal_al_init(mrb_state *mrb)
   mrb_define_method(mrb, class_Source, "max_distance=",       mrb_al_source_set_max_distance,       ARGS_REQ(1));
   mrb_define_method(mrb, class_Source, "pitch",               mrb_al_source_get_pitch,              ARGS_NONE());
   mrb_define_method(mrb, class_Source, "pitch=",              mrb_al_source_set_pitch,              ARGS_REQ(1));
-  mrb_define_method(mrb, class_Source, "direction",           mrb_al_source_get_direction,          ARGS_NONE());
+  mrb_define_method(mrb, class_Source, "position",            mrb_al_source_get_position,           ARGS_OPT(2));
+  mrb_define_method(mrb, class_Source, "position=",           mrb_al_source_set_position,           ARGS_REQ(1));
+  mrb_define_method(mrb, class_Source, "set_position",        mrb_al_source_set_position_at,        ARGS_REQ(1) | ARGS_OPT(2));
+  mrb_define_method(mrb, class_Source, "velocity",            mrb_al_source_get_velocity,           ARGS_OPT(2));
+  mrb_define_method(mrb, class_Source, "velocity=",           mrb_al_source_set_velocity,           ARGS_REQ(1));
+  mrb_define_method(mrb, class_Source, "set_velocity",        mrb_al_source_set_velocity_at,        ARGS_REQ(1) | ARGS_OPT(2));
+  mrb_define_method(mrb, class_Source, "direction",           mrb_al_source_get_direction,          ARGS_OPT(2));
+  mrb_define_method(mrb, class_Source, "direction=",          mrb_al_source_set_direction,          ARGS_REQ(1));
+  mrb_define_method(mrb, class_Source, "set_direction",       mrb_al_source_set_direction_at,       ARGS_REQ(1) | ARGS_OPT(2));
   mrb_define_method(mrb, class_Source, "cone_inner_angle",    mrb_al_source_get_cone_inner_angle,   ARGS_NONE());
   mrb_define_method(mrb, class_Source, "cone_outer_angle",    mrb_al_source_get_cone_outer_angle,   ARGS_NONE());
   mrb_define_method(mrb, class_Source, "cone_outer_gain",     mrb_al_source_get_cone_outer_gain,    ARGS_NONE());
   mrb_define_method(mrb, class_Source, "sec_offset",          mrb_al_source_get_sec_offset,         ARGS_NONE());
+  mrb_define_method(mrb, class_Source, "sec_offset=",         mrb_al_source_set_sec_offset,         ARGS_REQ(1));
   mrb_define_method(mrb, class_Source, "sample_offset",       mrb_al_source_get_sample_offset,      ARGS_NONE());
+  mrb_define_method(mrb, class_Source, "sample_offset=",      mrb_al_source_set_sample_offset,      ARGS_REQ(1));
   mrb_define_method(mrb, class_Source, "byte_offset",         mrb_al_source_get_byte_offset,        ARGS_NONE());
+  mrb_define_method(mrb, class_Source, "byte_offset=",        mrb_al_source_set_byte_offset,        ARGS_REQ(1));
+  mrb_define_method(mrb, class_Source, "sec_offset_latency",  mrb_al_source_get_sec_offset_latency, ARGS_NONE());
   mrb_define_method(mrb, class_Source, "playing?",            mrb_al_source_is_playing,             ARGS_NONE());
   mrb_define_method(mrb, class_Source, "playing=",            mrb_al_source_set_playing,            ARGS_REQ(1));
   mrb_define_method(mrb, class_Source, "state",               mrb_al_source_get_state,              ARGS_NONE());
@@ -1091,9 +1890,26 @@ mruby_openal_al_init(mrb_state *mrb)
   mrb_define_method(mrb, class_Source, "queue_buffers",       mrb_al_source_queue_buffers,          ARGS_REQ(1));
   mrb_define_method(mrb, class_Source, "unqueue_buffers",     mrb_al_source_unqueue_buffers,        ARGS_REQ(1));
 
+  mrb_define_class_method(mrb, class_Listener, "position",     mrb_al_listener_get_position,    ARGS_OPT(2));
+  mrb_define_class_method(mrb, class_Listener, "position=",    mrb_al_listener_set_position,    ARGS_REQ(1));
+  mrb_define_class_method(mrb, class_Listener, "velocity",     mrb_al_listener_get_velocity,    ARGS_OPT(2));
+  mrb_define_class_method(mrb, class_Listener, "velocity=",    mrb_al_listener_set_velocity,    ARGS_REQ(1));
+  mrb_define_class_method(mrb, class_Listener, "orientation",  mrb_al_listener_get_orientation, ARGS_OPT(2));
+  mrb_define_class_method(mrb, class_Listener, "orientation=", mrb_al_listener_set_orientation, ARGS_REQ(1));
+  mrb_define_class_method(mrb, class_Listener, "gain",         mrb_al_listener_get_gain,        ARGS_NONE());
+  mrb_define_class_method(mrb, class_Listener, "gain=",        mrb_al_listener_set_gain,        ARGS_REQ(1));
+  mrb_define_class_method(mrb, class_Listener, "update",       mrb_al_listener_update,          ARGS_REQ(1) | ARGS_OPT(3));
+
   mrb_define_const(mrb, class_Source, "UNDETERMINED", mrb_fixnum_value(AL_UNDETERMINED));
-  mrb_define_const(mrb, class_Source, "STATIC",       mrb_fixnum_value(AL_UNDETERMINED));
-  mrb_define_const(mrb, class_Source, "STREAMING",    mrb_fixnum_value(AL_UNDETERMINED));
+  mrb_define_const(mrb, class_Source, "STATIC",       mrb_fixnum_value(AL_STATIC));
+  mrb_define_const(mrb, class_Source, "STREAMING",    mrb_fixnum_value(AL_STREAMING));
+
+  mrb_define_const(mrb, class_Buffer, "FORMAT_MONO8",          mrb_fixnum_value(AL_FORMAT_MONO8));
+  mrb_define_const(mrb, class_Buffer, "FORMAT_MONO16",         mrb_fixnum_value(AL_FORMAT_MONO16));
+  mrb_define_const(mrb, class_Buffer, "FORMAT_STEREO8",        mrb_fixnum_value(AL_FORMAT_STEREO8));
+  mrb_define_const(mrb, class_Buffer, "FORMAT_STEREO16",       mrb_fixnum_value(AL_FORMAT_STEREO16));
+  mrb_define_const(mrb, class_Buffer, "FORMAT_MONO_FLOAT32",   mrb_fixnum_value(AL_FORMAT_MONO_FLOAT32));
+  mrb_define_const(mrb, class_Buffer, "FORMAT_STEREO_FLOAT32", mrb_fixnum_value(AL_FORMAT_STEREO_FLOAT32));
 
   mrb_define_const(mrb, class_Buffer, "WAVEFORM_SINE",       mrb_fixnum_value(ALUT_WAVEFORM_SINE));
   mrb_define_const(mrb, class_Buffer, "WAVEFORM_SQUARE",     mrb_fixnum_value(ALUT_WAVEFORM_SQUARE));
@@ -2,13 +2,18 @@
 #include "mruby/class.h"
 #include "mruby/string.h"
 #include "mruby/array.h"
+#include "mruby/variable.h"
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
 
 static struct RClass *mod_ALC = NULL;
 static struct RClass *class_Context = NULL;
 static struct RClass *class_Device = NULL;
 static struct RClass *class_CaptureDevice = NULL;
+static struct RClass *class_LoopbackDevice = NULL;
 static struct RClass *class_ALCError = NULL;
 
 typedef struct mrb_alc_context_data_t {
@@ -19,13 +24,58 @@ typedef struct mrb_alc_device_data_t {
   ALCdevice *device;
 } mrb_alc_device_data_t;
 
+typedef struct mrb_alc_capture_pump_t {
+  pthread_t      thread;
+  bool           started;
+  int            running;
+  mrb_al_ring_t *ring;
+  void          *buffer;
+  long           period_ns;
+  size_t         dropped;
+  int            error;
+} mrb_alc_capture_pump_t;
+
 typedef struct mrb_alc_capturedevice_data_t {
-  ALCdevice *device;
-  ALint      frequency;
-  ALenum     format;
-  ALsizei    samples;
+  ALCdevice             *device;
+  ALint                  frequency;
+  ALenum                 format;
+  ALsizei                samples;
+  size_t                 frame_size;
+  mrb_alc_capture_pump_t pump;
 } mrb_alc_capturedevice_data_t;
 
+/* from ALC_SOFT_loopback. the entry points are looked up at run time. */
+#ifndef ALC_FORMAT_CHANNELS_SOFT
+#define ALC_UNSIGNED_BYTE_SOFT   0x1401
+#define ALC_SHORT_SOFT           0x1402
+#define ALC_FLOAT_SOFT           0x1406
+#define ALC_MONO_SOFT            0x1500
+#define ALC_STEREO_SOFT          0x1501
+#define ALC_FORMAT_CHANNELS_SOFT 0x1990
+#define ALC_FORMAT_TYPE_SOFT     0x1991
+#endif
+
+typedef ALCdevice *(*mrb_alc_loopback_open_device_t)(ALCchar const *name);
+typedef ALCboolean (*mrb_alc_is_render_format_supported_t)(ALCdevice *device, ALCsizei frequency, ALCenum channels, ALCenum type);
+typedef void (*mrb_alc_render_samples_t)(ALCdevice *device, ALCvoid *buffer, ALCsizei samples);
+
+static mrb_alc_loopback_open_device_t       loopback_open_device = NULL;
+static mrb_alc_is_render_format_supported_t is_render_format_supported = NULL;
+static mrb_alc_render_samples_t             render_samples = NULL;
+
+/*
+ * a loopback device is a Device whose mix is pulled by render instead of
+ * being played, so it shares the Device data type and extends its data.
+ */
+typedef struct mrb_alc_loopbackdevice_data_t {
+  mrb_alc_device_data_t base;
+  ALCint                frequency;
+  ALenum                format;
+  ALCenum               channels;
+  ALCenum               type;
+  size_t                frame_size;
+} mrb_alc_loopbackdevice_data_t;
+
 static mrb_value specifier_to_array(mrb_state *mrb, ALchar const * const specifier);
 
 static void
@@ -52,11 +102,26 @@ mrb_alc_device_free(mrb_state *mrb, void *p)
   }
 }
 
+static void
+mrb_alc_capture_pump_stop(mrb_state *mrb, mrb_alc_capture_pump_t *pump)
+{
+  if (pump->started) {
+    __atomic_store_n(&pump->running, 0, __ATOMIC_RELEASE);
+    pthread_join(pump->thread, NULL);
+    pump->started = false;
+  }
+  mrb_free(mrb, pump->buffer);
+  pump->buffer = NULL;
+  mrb_al_ring_release(mrb, pump->ring);
+  pump->ring = NULL;
+}
+
 static void
 mrb_alc_capturedevice_free(mrb_state *mrb, void *p)
 {
   mrb_alc_capturedevice_data_t *data = (mrb_alc_capturedevice_data_t*)p;
   if (NULL != data) {
+    mrb_alc_capture_pump_stop(mrb, &data->pump);
     if (NULL != data->device) {
       alcCaptureCloseDevice(data->device);
     }
@@ -80,7 +145,7 @@ mrb_alc_context_initialize(mrb_state *mrb, mrb_value self)
   mrb_alc_device_data_t *device_data =
     (mrb_alc_device_data_t*)mrb_data_get_ptr(mrb, device, &mrb_alc_device_data_type);
   mrb_int i;
-  ALCint attrs[argc + 1];
+  ALCint attrs[argc + 7];
   for (i = 0; i < argc; ++i) {
     if (!mrb_fixnum_p(argv[i])) {
       if (mrb_respond_to(mrb, argv[i], mrb_intern(mrb, "to_i", 4))) {
@@ -91,6 +156,16 @@ mrb_alc_context_initialize(mrb_state *mrb, mrb_value self)
     }
     attrs[i] = (ALCint)mrb_fixnum(argv[i]);
   }
+  if (mrb_obj_is_kind_of(mrb, device, class_LoopbackDevice)) {
+    /* loopback contexts cannot be created without the render format. */
+    mrb_alc_loopbackdevice_data_t const *loopback_data = (mrb_alc_loopbackdevice_data_t const*)device_data;
+    attrs[argc++] = ALC_FREQUENCY;
+    attrs[argc++] = loopback_data->frequency;
+    attrs[argc++] = ALC_FORMAT_CHANNELS_SOFT;
+    attrs[argc++] = loopback_data->channels;
+    attrs[argc++] = ALC_FORMAT_TYPE_SOFT;
+    attrs[argc++] = loopback_data->type;
+  }
   attrs[argc] = 0;
   ALCcontext *context = alcCreateContext(device_data->device, attrs);
   if (NULL == context) {
@@ -107,6 +182,7 @@ mrb_alc_context_initialize(mrb_state *mrb, mrb_value self)
   context_data->context = context;
   DATA_PTR(self) = context_data;
   DATA_TYPE(self) = &mrb_alc_context_data_type;
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@device", 7), device);
   return mrb_nil_value();
 }
 
@@ -190,6 +266,29 @@ mrb_alc_context_suspend(mrb_state *mrb, mrb_value self)
   return mrb_nil_value();
 }
 
+/*
+ * the device of a Context created by Context.new, or NULL once the context
+ * has been destroyed or the device closed.
+ * contexts wrapped by Context.current do not know their device object, so
+ * there is nothing to tell whether the device is still open.
+ */
+ALCdevice*
+mrb_alc_context_device(mrb_state *mrb, mrb_value context)
+{
+  mrb_alc_context_data_t *data =
+    (mrb_alc_context_data_t*)mrb_data_get_ptr(mrb, context, &mrb_alc_context_data_type);
+  if (NULL == data->context) {
+    return NULL;
+  }
+  mrb_value const device = mrb_iv_get(mrb, context, mrb_intern(mrb, "@device", 7));
+  if (mrb_nil_p(device)) {
+    return NULL;
+  }
+  mrb_alc_device_data_t *device_data =
+    (mrb_alc_device_data_t*)mrb_data_get_ptr(mrb, device, &mrb_alc_device_data_type);
+  return device_data->device;
+}
+
 
 static mrb_value
 mrb_alc_device_initialize(mrb_state *mrb, mrb_value self)
@@ -360,8 +459,13 @@ mrb_alc_capturedevice_initialize(mrb_state *mrb, mrb_value self)
   if ((0 != argc) && (4 != argc)) {
     mrb_raise(mrb, E_ARGUMENT_ERROR, "wrong number of arguments.");
   }
+  size_t frame_size = 0;
   ALCdevice *device = NULL;
   if (0 != argc) {
+    frame_size = mrb_al_format_frame_size((ALenum)format);
+    if (0 == frame_size) {
+      mrb_raise(mrb, class_ALCError, "unsupported capture format.");
+    }
     device = alcCaptureOpenDevice(RSTRING_PTR(name), (ALCint)freq, (ALCenum)format, (ALCsizei)size);
     if (NULL == device) {
       mrb_raisef(mrb, class_ALCError, "cannot open capture device (%S).", name);
@@ -378,6 +482,17 @@ mrb_alc_capturedevice_initialize(mrb_state *mrb, mrb_value self)
     mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
   }
   data->device = device;
+  data->frequency = (0 != argc) ? (ALint)freq : 0;
+  data->format = (0 != argc) ? (ALenum)format : AL_NONE;
+  data->samples = (0 != argc) ? (ALsizei)size : 0;
+  data->frame_size = frame_size;
+  data->pump.started = false;
+  data->pump.running = 0;
+  data->pump.ring = NULL;
+  data->pump.buffer = NULL;
+  data->pump.period_ns = 0;
+  data->pump.dropped = 0;
+  data->pump.error = ALC_NO_ERROR;
   DATA_PTR(self) = data;
   DATA_TYPE(self) = &mrb_alc_capturedevice_data_type;
   return self;
@@ -394,6 +509,10 @@ mrb_alc_capturedevice_open(mrb_state *mrb, mrb_value self)
   mrb_value name;
   mrb_int freq, format, size;
   mrb_get_args(mrb, "oiii", &name, &freq, &format, &size);
+  size_t const frame_size = mrb_al_format_frame_size((ALenum)format);
+  if (0 == frame_size) {
+    mrb_raise(mrb, class_ALCError, "unsupported capture format.");
+  }
   ALCdevice *device = alcCaptureOpenDevice(RSTRING_PTR(name), (ALCint)freq, (ALCenum)format, (ALCsizei)size);
   if (NULL == device) {
     mrb_raisef(mrb, class_ALCError, "cannot open capture device (%S).", name);
@@ -402,6 +521,7 @@ mrb_alc_capturedevice_open(mrb_state *mrb, mrb_value self)
   data->frequency = freq;
   data->format = format;
   data->samples = size;
+  data->frame_size = frame_size;
   return self;
 }
 
@@ -410,6 +530,8 @@ mrb_alc_capturedevice_close(mrb_state *mrb, mrb_value self)
 {
   mrb_alc_capturedevice_data_t *data =
     (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  mrb_alc_capture_pump_stop(mrb, &data->pump);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@pump_ring", 10), mrb_nil_value());
   if (NULL != data->device) {
     if (alcCaptureCloseDevice(data->device) == ALC_FALSE) {
       mrb_raise(mrb, class_ALCError, alcGetString(data->device, alcGetError(data->device)));
@@ -451,6 +573,10 @@ mrb_alc_capturedevice_stop(mrb_state *mrb, mrb_value self)
   return self;
 }
 
+/*
+ * appends up to 'count' frames after the current size of the sample buffer.
+ * returns the number of frames actually captured.
+ */
 static mrb_value
 mrb_alc_capturedevice_samples(mrb_state *mrb, mrb_value self)
 {
@@ -459,45 +585,183 @@ mrb_alc_capturedevice_samples(mrb_state *mrb, mrb_value self)
   if (NULL == data->device) {
     mrb_raise(mrb, class_ALCError, "no device is opened.");
   }
+  if (data->pump.started) {
+    mrb_raise(mrb, class_ALCError, "capture pump is running.");
+  }
   mrb_value buf;
   mrb_int sample;
   int const argc = mrb_get_args(mrb, "o|i", &buf, &sample);
   mrb_al_sample_buffer_data_t *buf_data =
     (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, buf, &mrb_al_sample_buffer_data_type);
-  ALsizei coef = 1;
-  switch (data->format) {
-  case AL_FORMAT_MONO8:
-    coef = 1;
-    break;
-  case AL_FORMAT_MONO16:
-    coef = 2;
-    break;
-  case AL_FORMAT_STEREO8:
-    coef = 2;
-    break;
-  case AL_FORMAT_STEREO16:
-    coef = 4;
-    break;
-  default:
-    mrb_raise(mrb, class_ALCError, "capture device is opened as unsupported format.");
-    break;
-  }
-  ALsizei sample_count = buf_data->capacity / coef;
+  ALCsizei sample_count = (ALCsizei)((buf_data->capacity - buf_data->size) / data->frame_size);
   if (1 < argc) {
-    if (sample_count > (ALsizei)sample) {
+    if ((sample < 0) || ((ALCsizei)sample > sample_count)) {
       mrb_raise(mrb, E_ARGUMENT_ERROR, "too many sampling count is supplied.");
     }
-    sample_count = (ALsizei)sample;
+    sample_count = (ALCsizei)sample;
   }
-  alcCaptureSamples(data->device, buf_data->buffer, sample_count);
-  ALCenum const e = alcGetError(data->device);
-  if (ALC_NO_ERROR != e) {
-    mrb_raise(mrb, class_ALCError, alcGetString(data->device, e));
+  ALCint available = 0;
+  alcGetIntegerv(data->device, ALC_CAPTURE_SAMPLES, 1, &available);
+  if (available < sample_count) {
+    sample_count = available;
+  }
+  if (0 < sample_count) {
+    alcCaptureSamples(data->device, (unsigned char*)buf_data->buffer + buf_data->size, sample_count);
+    ALCenum const e = alcGetError(data->device);
+    if (ALC_NO_ERROR != e) {
+      mrb_raise(mrb, class_ALCError, alcGetString(data->device, e));
+    }
+    buf_data->size += sample_count * data->frame_size;
+  }
+  return mrb_fixnum_value(sample_count);
+}
+
+static mrb_value
+mrb_alc_capturedevice_get_available(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  if (NULL == data->device) {
+    mrb_raise(mrb, class_ALCError, "no device is opened.");
+  }
+  ALCint available = 0;
+  alcGetIntegerv(data->device, ALC_CAPTURE_SAMPLES, 1, &available);
+  return mrb_fixnum_value(available);
+}
+
+static mrb_value
+mrb_alc_capturedevice_get_frame_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  return mrb_fixnum_value(data->frame_size);
+}
+
+/* records why the pump gave up and lets the worker leave its loop. */
+static void
+mrb_alc_capture_pump_fail(mrb_alc_capture_pump_t *pump, ALCenum e)
+{
+  __atomic_store_n(&pump->error, (int)e, __ATOMIC_RELAXED);
+  __atomic_store_n(&pump->running, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * drains every available frame so that the device never overruns.
+ * only whole frames are stored; frames which do not fit into the ring are
+ * counted as dropped.
+ * the pump stops on the first device error, which is kept for #pump_error.
+ */
+static void*
+mrb_alc_capture_pump_worker(void *p)
+{
+  mrb_alc_capturedevice_data_t *data = (mrb_alc_capturedevice_data_t*)p;
+  mrb_alc_capture_pump_t *pump = &data->pump;
+  struct timespec const period = { pump->period_ns / 1000000000L, pump->period_ns % 1000000000L };
+  while (__atomic_load_n(&pump->running, __ATOMIC_ACQUIRE)) {
+    ALCint available = 0;
+    alcGetIntegerv(data->device, ALC_CAPTURE_SAMPLES, 1, &available);
+    ALCenum e = alcGetError(data->device);
+    if ((ALC_NO_ERROR != e) || (available < 0)) {
+      mrb_alc_capture_pump_fail(pump, (ALC_NO_ERROR != e) ? e : ALC_INVALID_VALUE);
+      break;
+    }
+    while (0 < available) {
+      ALCsizei const count = (available < data->samples) ? available : data->samples;
+      size_t const size = (size_t)count * data->frame_size;
+      alcCaptureSamples(data->device, pump->buffer, count);
+      e = alcGetError(data->device);
+      if (ALC_NO_ERROR != e) {
+        mrb_alc_capture_pump_fail(pump, e);
+        return NULL;
+      }
+      size_t space = mrb_al_ring_free_space(pump->ring);
+      space -= space % data->frame_size;
+      size_t const written = mrb_al_ring_write(pump->ring, pump->buffer, (size < space) ? size : space);
+      __atomic_fetch_add(&pump->dropped, (size - written) / data->frame_size, __ATOMIC_RELAXED);
+      available -= count;
+    }
+    nanosleep(&period, NULL);
+  }
+  return NULL;
+}
+
+static mrb_value
+mrb_alc_capturedevice_start_pump(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  if (NULL == data->device) {
+    mrb_raise(mrb, class_ALCError, "no device is opened.");
   }
-  buf_data->size = sample_count * coef;
+  if (data->pump.started) {
+    mrb_raise(mrb, class_ALCError, "capture pump has already been started.");
+  }
+  mrb_value ring;
+  mrb_float period = 0.01;
+  mrb_get_args(mrb, "o|f", &ring, &period);
+  if (period <= 0.0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "period must be positive.");
+  }
+  mrb_al_ring_t *ring_data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, ring, &mrb_al_ring_data_type);
+  mrb_alc_capture_pump_t *pump = &data->pump;
+  pump->buffer = mrb_malloc(mrb, data->frame_size * data->samples);
+  if (NULL == pump->buffer) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  /* the worker keeps the storage alive even if the RingBuffer is collected first. */
+  mrb_al_ring_retain(ring_data);
+  pump->ring = ring_data;
+  pump->period_ns = (long)(period * 1000000000.0);
+  pump->dropped = 0;
+  pump->error = ALC_NO_ERROR;
+  pump->running = 1;
+  if (0 != pthread_create(&pump->thread, NULL, mrb_alc_capture_pump_worker, data)) {
+    mrb_alc_capture_pump_stop(mrb, pump);
+    mrb_raise(mrb, E_RUNTIME_ERROR, "cannot start capture pump thread.");
+  }
+  pump->started = true;
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@pump_ring", 10), ring);
   return self;
 }
 
+static mrb_value
+mrb_alc_capturedevice_stop_pump(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  mrb_alc_capture_pump_stop(mrb, &data->pump);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@pump_ring", 10), mrb_nil_value());
+  return self;
+}
+
+/* false once the pump has been stopped or has given up on a device error. */
+static mrb_value
+mrb_alc_capturedevice_is_pumping(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  return (data->pump.started && __atomic_load_n(&data->pump.running, __ATOMIC_ACQUIRE)) ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_alc_capturedevice_get_dropped(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  return mrb_fixnum_value(__atomic_load_n(&data->pump.dropped, __ATOMIC_RELAXED));
+}
+
+/* the device error that stopped the pump since it was last started, or nil. */
+static mrb_value
+mrb_alc_capturedevice_get_pump_error(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_capturedevice_data_t *data =
+    (mrb_alc_capturedevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_capturedevice_data_type);
+  ALCenum const e = (ALCenum)__atomic_load_n(&data->pump.error, __ATOMIC_RELAXED);
+  return (ALC_NO_ERROR == e) ? mrb_nil_value() : mrb_str_new_cstr(mrb, alcGetString(data->device, e));
+}
+
 static mrb_value
 mrb_alc_capturedevice_get_device_specifier(mrb_state *mrb, mrb_value self)
 {
@@ -539,17 +803,178 @@ specifier_to_array(mrb_state *mrb, ALchar const * const specifier)
 }
 
 
+static void
+mrb_alc_loopback_resolve(mrb_state *mrb)
+{
+  if (NULL != render_samples) {
+    return;
+  }
+  if (!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback")) {
+    mrb_raise(mrb, class_ALCError, "ALC_SOFT_loopback is not supported.");
+  }
+  loopback_open_device = (mrb_alc_loopback_open_device_t)alcGetProcAddress(NULL, "alcLoopbackOpenDeviceSOFT");
+  is_render_format_supported = (mrb_alc_is_render_format_supported_t)alcGetProcAddress(NULL, "alcIsRenderFormatSupportedSOFT");
+  render_samples = (mrb_alc_render_samples_t)alcGetProcAddress(NULL, "alcRenderSamplesSOFT");
+  if ((NULL == loopback_open_device) || (NULL == is_render_format_supported) || (NULL == render_samples)) {
+    render_samples = NULL;
+    mrb_raise(mrb, class_ALCError, "ALC_SOFT_loopback is not supported.");
+  }
+}
+
+static ALCdevice*
+mrb_alc_loopback_open(mrb_state *mrb, mrb_alc_loopbackdevice_data_t const *data, mrb_value name)
+{
+  if (!mrb_nil_p(name) && !mrb_string_p(name)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "device name must be string type.");
+  }
+  ALCdevice *device = loopback_open_device(mrb_nil_p(name) ? NULL : RSTRING_PTR(name));
+  if (NULL == device) {
+    mrb_raise(mrb, class_ALCError, "cannot open loopback device.");
+  }
+  if (!is_render_format_supported(device, data->frequency, data->channels, data->type)) {
+    alcCloseDevice(device);
+    mrb_raise(mrb, class_ALCError, "unsupported render format.");
+  }
+  return device;
+}
+
+/*
+ * LoopbackDevice.new(frequency, format[, name])
+ * 'format' is one of the AL::Buffer::FORMAT_* values and fixes the layout
+ * of the rendered samples.
+ */
+static mrb_value
+mrb_alc_loopbackdevice_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)DATA_PTR(self);
+  mrb_int freq, format;
+  mrb_value name = mrb_nil_value();
+  mrb_get_args(mrb, "ii|o", &freq, &format, &name);
+  if (freq <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "frequency must be positive.");
+  }
+  mrb_al_pcm_format_t info;
+  mrb_al_pcm_get_format(mrb, format, &info);
+  mrb_alc_loopback_resolve(mrb);
+
+  if (NULL != data) {
+    mrb_alc_device_free(mrb, data);
+    DATA_PTR(self) = NULL;
+  }
+  data = (mrb_alc_loopbackdevice_data_t*)mrb_malloc(mrb, sizeof(mrb_alc_loopbackdevice_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->base.device = NULL;
+  data->frequency = (ALCint)freq;
+  data->format = (ALenum)format;
+  data->channels = (2 == info.channels) ? ALC_STEREO_SOFT : ALC_MONO_SOFT;
+  data->type =
+    (MRB_AL_PCM_U8 == info.type)  ? ALC_UNSIGNED_BYTE_SOFT :
+    (MRB_AL_PCM_S16 == info.type) ? ALC_SHORT_SOFT : ALC_FLOAT_SOFT;
+  data->frame_size = info.sample_size * info.channels;
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_alc_device_data_type;
+
+  data->base.device = mrb_alc_loopback_open(mrb, data, name);
+  return self;
+}
+
+static mrb_value
+mrb_alc_loopbackdevice_open(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_device_data_type);
+  if (NULL != data->base.device) {
+    mrb_raise(mrb, class_ALCError, "device has already opened.");
+  }
+  mrb_value name = mrb_nil_value();
+  mrb_get_args(mrb, "|o", &name);
+  data->base.device = mrb_alc_loopback_open(mrb, data, name);
+  return self;
+}
+
+/*
+ * mixes 'frames' frames of the device's context and appends them to 'buf',
+ * growing it as needed. without 'frames' the free capacity is filled.
+ * runs as fast as the mixer does; returns the number of frames rendered.
+ */
+static mrb_value
+mrb_alc_loopbackdevice_render(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_device_data_type);
+  if (NULL == data->base.device) {
+    mrb_raise(mrb, class_ALCError, "no device is opened.");
+  }
+  mrb_value buf;
+  mrb_int frames;
+  int const argc = mrb_get_args(mrb, "o|i", &buf, &frames);
+  mrb_al_sample_buffer_data_t *buf_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, buf, &mrb_al_sample_buffer_data_type);
+  if (1 < argc) {
+    if (frames < 0) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "frame count must not be negative.");
+    }
+    mrb_al_sample_buffer_reserve(mrb, buf_data, buf_data->size + (size_t)frames * data->frame_size);
+  } else {
+    frames = (mrb_int)((buf_data->capacity - buf_data->size) / data->frame_size);
+  }
+  if (0 < frames) {
+    render_samples(data->base.device, (unsigned char*)buf_data->buffer + buf_data->size, (ALCsizei)frames);
+    ALCenum const e = alcGetError(data->base.device);
+    if (ALC_NO_ERROR != e) {
+      mrb_raise(mrb, class_ALCError, alcGetString(data->base.device, e));
+    }
+    buf_data->size += (size_t)frames * data->frame_size;
+  }
+  return mrb_fixnum_value(frames);
+}
+
+static mrb_value
+mrb_alc_loopbackdevice_get_frequency(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_device_data_type);
+  return mrb_fixnum_value(data->frequency);
+}
+
+static mrb_value
+mrb_alc_loopbackdevice_get_format(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_device_data_type);
+  return mrb_fixnum_value(data->format);
+}
+
+static mrb_value
+mrb_alc_loopbackdevice_get_frame_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_alc_loopbackdevice_data_t *data =
+    (mrb_alc_loopbackdevice_data_t*)mrb_data_get_ptr(mrb, self, &mrb_alc_device_data_type);
+  return mrb_fixnum_value(data->frame_size);
+}
+
+static mrb_value
+mrb_alc_loopbackdevice_is_supported(mrb_state *mrb, mrb_value self)
+{
+  return alcIsExtensionPresent(NULL, "ALC_SOFT_loopback") ? mrb_true_value() : mrb_false_value();
+}
+
 void mruby_openal_alc_init(mrb_state *mrb)
 {
   mod_ALC = mrb_define_module(mrb, "ALC");
   class_Context       = mrb_define_class_under(mrb, mod_ALC, "Context",       mrb->object_class);
   class_Device        = mrb_define_class_under(mrb, mod_ALC, "Device",        mrb->object_class);
   class_CaptureDevice = mrb_define_class_under(mrb, mod_ALC, "CaptureDevice", class_Device);
+  class_LoopbackDevice = mrb_define_class_under(mrb, mod_ALC, "LoopbackDevice", class_Device);
   class_ALCError      = mrb_define_class_under(mrb, mod_ALC, "ALCError",      mrb->eStandardError_class);
 
   MRB_SET_INSTANCE_TT(class_Context,       MRB_TT_DATA);
   MRB_SET_INSTANCE_TT(class_Device,        MRB_TT_DATA);
   MRB_SET_INSTANCE_TT(class_CaptureDevice, MRB_TT_DATA);
+  MRB_SET_INSTANCE_TT(class_LoopbackDevice, MRB_TT_DATA);
 
   mrb_define_method(mrb, class_Context, "initialize", mrb_alc_context_initialize,   ARGS_ANY());
   mrb_define_method(mrb, class_Context, "destroy",    mrb_alc_context_destroy,      ARGS_NONE());
@@ -575,10 +1000,25 @@ void mruby_openal_alc_init(mrb_state *mrb)
   mrb_define_method(mrb, class_CaptureDevice, "close",      mrb_alc_capturedevice_close,      ARGS_NONE());
   mrb_define_method(mrb, class_CaptureDevice, "start",      mrb_alc_capturedevice_start,      ARGS_NONE());
   mrb_define_method(mrb, class_CaptureDevice, "stop",       mrb_alc_capturedevice_stop,       ARGS_NONE());
-  mrb_define_method(mrb, class_CaptureDevice, "samples",    mrb_alc_capturedevice_samples,    ARGS_REQ(2));
+  mrb_define_method(mrb, class_CaptureDevice, "samples",    mrb_alc_capturedevice_samples,    ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_CaptureDevice, "available",  mrb_alc_capturedevice_get_available, ARGS_NONE());
+  mrb_define_method(mrb, class_CaptureDevice, "frame_size", mrb_alc_capturedevice_get_frame_size, ARGS_NONE());
+  mrb_define_method(mrb, class_CaptureDevice, "start_pump", mrb_alc_capturedevice_start_pump, ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_CaptureDevice, "stop_pump",  mrb_alc_capturedevice_stop_pump,  ARGS_NONE());
+  mrb_define_method(mrb, class_CaptureDevice, "pumping?",   mrb_alc_capturedevice_is_pumping, ARGS_NONE());
+  mrb_define_method(mrb, class_CaptureDevice, "dropped",    mrb_alc_capturedevice_get_dropped, ARGS_NONE());
+  mrb_define_method(mrb, class_CaptureDevice, "pump_error", mrb_alc_capturedevice_get_pump_error, ARGS_NONE());
   mrb_define_class_method(mrb, class_CaptureDevice, "device_specifier",         mrb_alc_capturedevice_get_device_specifier,         ARGS_NONE());
   mrb_define_class_method(mrb, class_CaptureDevice, "default_device_specifier", mrb_alc_capturedevice_get_default_device_specifier, ARGS_NONE());
 
+  mrb_define_method(mrb, class_LoopbackDevice, "initialize", mrb_alc_loopbackdevice_initialize,     ARGS_REQ(2) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_LoopbackDevice, "open",       mrb_alc_loopbackdevice_open,           ARGS_OPT(1));
+  mrb_define_method(mrb, class_LoopbackDevice, "render",     mrb_alc_loopbackdevice_render,         ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_LoopbackDevice, "frequency",  mrb_alc_loopbackdevice_get_frequency,  ARGS_NONE());
+  mrb_define_method(mrb, class_LoopbackDevice, "format",     mrb_alc_loopbackdevice_get_format,     ARGS_NONE());
+  mrb_define_method(mrb, class_LoopbackDevice, "frame_size", mrb_alc_loopbackdevice_get_frame_size, ARGS_NONE());
+  mrb_define_class_method(mrb, class_LoopbackDevice, "supported?", mrb_alc_loopbackdevice_is_supported, ARGS_NONE());
+
   mrb_define_const(mrb, mod_ALC, "FORMAT_MONO8",    mrb_fixnum_value(AL_FORMAT_MONO8));
   mrb_define_const(mrb, mod_ALC, "FORMAT_MONO16",   mrb_fixnum_value(AL_FORMAT_MONO16));
   mrb_define_const(mrb, mod_ALC, "FORMAT_STEREO8",  mrb_fixnum_value(AL_FORMAT_STEREO8));
@@ -0,0 +1,306 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/array.h"
+#include "mruby/string.h"
+#include "mruby/variable.h"
+#include <AL/al.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct RClass *class_BankLoader = NULL;
+
+/*
+ * one asset. everything but 'path' is written by a worker thread and
+ * published to the mruby thread through 'done' under 'lock'.
+ */
+typedef struct mrb_al_bank_entry_t {
+  char          *path;
+  unsigned char *pcm;
+  size_t         pcm_size;
+  ALenum         format;
+  ALsizei        frequency;
+  char const    *error;
+  bool           done;
+} mrb_al_bank_entry_t;
+
+/*
+ * 'next' is the next entry to decode and 'uploaded' the number of entries
+ * the mruby thread has consumed. workers stay at most 'window' entries
+ * ahead, so decoded samples waiting for upload are bounded.
+ */
+typedef struct mrb_al_bank_loader_data_t {
+  mrb_int              size;
+  mrb_al_bank_entry_t *entries;
+  mrb_int              thread_count;
+  pthread_t           *threads;
+  mrb_int              started;
+  mrb_int              next;
+  mrb_int              uploaded;
+  mrb_int              window;
+  bool                 cancelled;
+  pthread_mutex_t      lock;
+  pthread_cond_t       cond;
+} mrb_al_bank_loader_data_t;
+
+/* stops the workers, which may be waiting for the window, and waits for them. */
+static void
+mrb_al_bank_loader_join(mrb_al_bank_loader_data_t *data)
+{
+  if (0 == data->started) {
+    return;
+  }
+  pthread_mutex_lock(&data->lock);
+  data->cancelled = true;
+  pthread_cond_broadcast(&data->cond);
+  pthread_mutex_unlock(&data->lock);
+  mrb_int i;
+  for (i = 0; i < data->started; ++i) {
+    pthread_join(data->threads[i], NULL);
+  }
+  data->started = 0;
+}
+
+static void
+mrb_al_bank_loader_free(mrb_state *mrb, void *p)
+{
+  mrb_al_bank_loader_data_t *data = (mrb_al_bank_loader_data_t*)p;
+  if (NULL != data) {
+    mrb_al_bank_loader_join(data);
+    pthread_cond_destroy(&data->cond);
+    pthread_mutex_destroy(&data->lock);
+    if (NULL != data->entries) {
+      mrb_int i;
+      for (i = 0; i < data->size; ++i) {
+        mrb_free(mrb, data->entries[i].path);
+        free(data->entries[i].pcm);
+      }
+      mrb_free(mrb, data->entries);
+    }
+    mrb_free(mrb, data->threads);
+    mrb_free(mrb, data);
+  }
+}
+
+static struct mrb_data_type const mrb_al_bank_loader_data_type = { "BankLoader", mrb_al_bank_loader_free };
+
+/*
+ * decodes one file through the decoders of AL::Stream, which pick WAV,
+ * Ogg Vorbis or FLAC by magic number. runs on a worker thread.
+ */
+static void
+mrb_al_bank_loader_decode(mrb_al_bank_entry_t *entry)
+{
+  entry->error = mrb_al_decode_file(entry->path, &entry->format, &entry->frequency, &entry->pcm, &entry->pcm_size);
+}
+
+static void*
+mrb_al_bank_loader_worker(void *p)
+{
+  mrb_al_bank_loader_data_t *data = (mrb_al_bank_loader_data_t*)p;
+  for (;;) {
+    pthread_mutex_lock(&data->lock);
+    while (!data->cancelled && (data->next < data->size) && (data->next >= data->uploaded + data->window)) {
+      pthread_cond_wait(&data->cond, &data->lock);
+    }
+    if (data->cancelled || (data->next >= data->size)) {
+      pthread_mutex_unlock(&data->lock);
+      break;
+    }
+    mrb_int const index = data->next++;
+    pthread_mutex_unlock(&data->lock);
+    mrb_al_bank_entry_t *entry = &data->entries[index];
+    mrb_al_bank_loader_decode(entry);
+    pthread_mutex_lock(&data->lock);
+    entry->done = true;
+    pthread_cond_broadcast(&data->cond);
+    pthread_mutex_unlock(&data->lock);
+  }
+  return NULL;
+}
+
+static mrb_value
+mrb_al_bankloader_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_bank_loader_data_t *data =
+    (mrb_al_bank_loader_data_t*)DATA_PTR(self);
+  mrb_value paths;
+  mrb_int thread_count = 4;
+  mrb_int window = 0;
+  int const argc = mrb_get_args(mrb, "A|ii", &paths, &thread_count, &window);
+
+  if (thread_count <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "thread count must be positive.");
+  }
+  if (argc < 3) {
+    window = thread_count * 2;
+  }
+  if (window <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "window must be positive.");
+  }
+  mrb_int const size = RARRAY_LEN(paths);
+  if (0 == size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "paths must not be empty.");
+  }
+  mrb_int i;
+  for (i = 0; i < size; ++i) {
+    if (!mrb_string_p(RARRAY_PTR(paths)[i])) {
+      mrb_raise(mrb, E_TYPE_ERROR, "paths must be string type.");
+    }
+  }
+
+  if (NULL != data) {
+    mrb_al_bank_loader_free(mrb, data);
+  }
+  data = (mrb_al_bank_loader_data_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_bank_loader_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  pthread_mutex_init(&data->lock, NULL);
+  pthread_cond_init(&data->cond, NULL);
+  data->thread_count = (thread_count < size) ? thread_count : size;
+  data->window = window;
+
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_bank_loader_data_type;
+
+  data->entries = (mrb_al_bank_entry_t*)mrb_calloc(mrb, size, sizeof(mrb_al_bank_entry_t));
+  data->threads = (pthread_t*)mrb_calloc(mrb, data->thread_count, sizeof(pthread_t));
+  if ((NULL == data->entries) || (NULL == data->threads)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->size = size;
+  for (i = 0; i < size; ++i) {
+    mrb_value const path = RARRAY_PTR(paths)[i];
+    char *copy = (char*)mrb_malloc(mrb, RSTRING_LEN(path) + 1);
+    if (NULL == copy) {
+      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+    }
+    memcpy(copy, RSTRING_PTR(path), RSTRING_LEN(path));
+    copy[RSTRING_LEN(path)] = '\0';
+    data->entries[i].path = copy;
+  }
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@paths", 6), paths);
+
+  return self;
+}
+
+/*
+ * decodes every file on the worker threads and uploads them in order on
+ * the calling thread, which owns the AL context.
+ * the block, if any, receives (loaded, total, path) after each upload.
+ */
+static mrb_value
+mrb_al_bankloader_load(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_bank_loader_data_t *data =
+    (mrb_al_bank_loader_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_bank_loader_data_type);
+  mrb_value block;
+  mrb_get_args(mrb, "&", &block);
+
+  if ((0 != data->started) || (0 != data->next)) {
+    mrb_raise(mrb, class_ALError, "bank has already been loaded.");
+  }
+  mrb_value arg = mrb_fixnum_value(data->size);
+  mrb_value const buffers = mrb_obj_new(mrb, class_Buffers, 1, &arg);
+  mrb_al_buffers_data_t *buffers_data =
+    (mrb_al_buffers_data_t*)mrb_data_get_ptr(mrb, buffers, &mrb_al_buffers_data_type);
+
+  mrb_int i;
+  for (i = 0; i < data->thread_count; ++i) {
+    if (0 != pthread_create(&data->threads[i], NULL, mrb_al_bank_loader_worker, data)) {
+      break;
+    }
+    ++data->started;
+  }
+  if (0 == data->started) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "cannot start loader thread.");
+  }
+
+  mrb_value const paths = mrb_iv_get(mrb, self, mrb_intern(mrb, "@paths", 6));
+  char const *error = NULL;
+  for (i = 0; i < data->size; ++i) {
+    mrb_al_bank_entry_t *entry = &data->entries[i];
+    pthread_mutex_lock(&data->lock);
+    while (!entry->done) {
+      pthread_cond_wait(&data->cond, &data->lock);
+    }
+    pthread_mutex_unlock(&data->lock);
+
+    if (NULL == entry->error) {
+      mrb_al_fetch_error();
+      alBufferData(buffers_data->buffers[i], entry->format, entry->pcm, (ALsizei)entry->pcm_size, entry->frequency);
+      ALenum const e = mrb_al_fetch_error();
+      if (AL_NO_ERROR != e) {
+        entry->error = alGetString(e);
+      }
+    }
+    free(entry->pcm);
+    entry->pcm = NULL;
+    pthread_mutex_lock(&data->lock);
+    data->uploaded = i + 1;
+    pthread_cond_broadcast(&data->cond);
+    pthread_mutex_unlock(&data->lock);
+    if ((NULL != entry->error) && (NULL == error)) {
+      error = entry->error;
+      mrb_iv_set(mrb, self, mrb_intern(mrb, "@failed_path", 12), mrb_ary_ref(mrb, paths, i));
+    }
+    if (!mrb_nil_p(block)) {
+      int const ai = mrb_gc_arena_save(mrb);
+      mrb_value argv[3] = { mrb_fixnum_value(i + 1), mrb_fixnum_value(data->size), mrb_ary_ref(mrb, paths, i) };
+      mrb_yield_argv(mrb, block, 3, argv);
+      mrb_gc_arena_restore(mrb, ai);
+    }
+  }
+  mrb_al_bank_loader_join(data);
+
+  if (NULL != error) {
+    mrb_raisef(mrb, class_ALError, "cannot load (%S): %S",
+      mrb_iv_get(mrb, self, mrb_intern(mrb, "@failed_path", 12)), mrb_str_new_cstr(mrb, error));
+  }
+  return buffers;
+}
+
+static mrb_value
+mrb_al_bankloader_get_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_bank_loader_data_t *data =
+    (mrb_al_bank_loader_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_bank_loader_data_type);
+  return mrb_fixnum_value(data->size);
+}
+
+static mrb_value
+mrb_al_bankloader_get_threads(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_bank_loader_data_t *data =
+    (mrb_al_bank_loader_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_bank_loader_data_type);
+  return mrb_fixnum_value(data->thread_count);
+}
+
+static mrb_value
+mrb_al_bankloader_get_window(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_bank_loader_data_t *data =
+    (mrb_al_bank_loader_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_bank_loader_data_type);
+  return mrb_fixnum_value(data->window);
+}
+
+void
+mruby_openal_bankloader_init(mrb_state *mrb)
+{
+  class_BankLoader = mrb_define_class_under(mrb, mod_AL, "BankLoader", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_BankLoader, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_BankLoader, "initialize", mrb_al_bankloader_initialize,  ARGS_REQ(1) | ARGS_OPT(2));
+  mrb_define_method(mrb, class_BankLoader, "load",       mrb_al_bankloader_load,        ARGS_BLOCK());
+  mrb_define_method(mrb, class_BankLoader, "size",       mrb_al_bankloader_get_size,    ARGS_NONE());
+  mrb_define_method(mrb, class_BankLoader, "threads",    mrb_al_bankloader_get_threads, ARGS_NONE());
+  mrb_define_method(mrb, class_BankLoader, "window",     mrb_al_bankloader_get_window,  ARGS_NONE());
+}
+
+void
+mruby_openal_bankloader_final(mrb_state *mrb)
+{
+}
@@ -0,0 +1,331 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/variable.h"
+#include <AL/al.h>
+#include <AL/alc.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* from ALC_SOFT_device_clock. the entry point is looked up at run time. */
+#ifndef ALC_DEVICE_CLOCK_LATENCY_SOFT
+#define ALC_DEVICE_CLOCK_LATENCY_SOFT 0x1602
+#endif
+
+/* a measurement this far off the prediction is a seek, not drift. */
+#define MRB_AL_CLOCK_RESYNC_THRESHOLD 0.25
+
+typedef void (*mrb_alc_get_integer64v_t)(ALCdevice *device, ALCenum param, ALCsizei size, int64_t *values);
+typedef bool (*mrb_al_clock_position_t)(mrb_value stream, ALuint *source, double *offset, double *latency, bool *exact);
+
+static struct RClass *class_Clock = NULL;
+
+/*
+ * playback time of a source, predicted from the monotonic host clock.
+ * AL is sampled at most once per 'interval'; each sample corrects the
+ * prediction through a second order loop of 'bandwidth' Hz, so reads in
+ * between cost one clock_gettime.
+ * AL resets the offset of a queued source on every unqueue, so streams are
+ * measured through 'position', which adds what they have unqueued.
+ * the device clock is read through the Context in @context, and only while
+ * its device is open.
+ */
+typedef struct mrb_al_clock_data_t {
+  ALuint                   source;
+  mrb_al_clock_position_t  position;
+  mrb_alc_get_integer64v_t get_integer64v;
+  int64_t                  device_clock;
+  double                   interval;
+  double                   bandwidth;
+  double                   host_base;
+  double                   media_base;
+  double                   rate;
+  double                   latency;
+  double                   last_sample;
+  double                   last_time;
+  bool                     sampled;
+  bool                     running;
+} mrb_al_clock_data_t;
+
+static void
+mrb_al_clock_free(mrb_state *mrb, void *p)
+{
+  mrb_free(mrb, p);
+}
+
+static struct mrb_data_type const mrb_al_clock_data_type = { "Clock", mrb_al_clock_free };
+
+static double
+mrb_al_clock_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+mrb_al_clock_restart(mrb_al_clock_data_t *data, double now, double media)
+{
+  data->host_base = now;
+  data->media_base = media;
+  data->rate = 1.0;
+  data->last_time = media;
+}
+
+/* takes one measurement of the audible position and feeds it to the loop. */
+static void
+mrb_al_clock_sample(mrb_state *mrb, mrb_value self, mrb_al_clock_data_t *data, double now)
+{
+  ALuint source = data->source;
+  double offset, latency;
+  bool exact;
+  if (NULL != data->position) {
+    data->position(mrb_iv_get(mrb, self, mrb_intern(mrb, "@source", 7)), &source, &offset, &latency, &exact);
+  } else {
+    exact = mrb_al_source_offset_latency(source, &offset, &latency);
+  }
+  ALint state = AL_STOPPED;
+  if (0 != source) {
+    alGetSourcei(source, AL_SOURCE_STATE, &state);
+  }
+  mrb_al_check_error(mrb);
+  data->last_sample = now;
+  data->sampled = true;
+
+  ALCdevice *device = NULL;
+  if (NULL != data->get_integer64v) {
+    device = mrb_alc_context_device(mrb, mrb_iv_get(mrb, self, mrb_intern(mrb, "@context", 8)));
+  }
+  if (NULL != device) {
+    int64_t values[2] = { 0, 0 };
+    data->get_integer64v(device, ALC_DEVICE_CLOCK_LATENCY_SOFT, 2, values);
+    if (!exact) {
+      latency = values[1] * 1e-9;
+    }
+    /* the mixer has not run since the last sample, so the offset is stale. */
+    if (data->running && (AL_PLAYING == state) && (values[0] == data->device_clock)) {
+      return;
+    }
+    data->device_clock = values[0];
+  }
+  data->latency = latency;
+  double const media = (offset > latency) ? offset - latency : 0.0;
+
+  if (AL_PLAYING != state) {
+    data->running = false;
+    mrb_al_clock_restart(data, now, media);
+    return;
+  }
+  if (!data->running) {
+    data->running = true;
+    mrb_al_clock_restart(data, now, media);
+    return;
+  }
+  double const dt = now - data->host_base;
+  double const predicted = data->media_base + data->rate * dt;
+  double const e = media - predicted;
+  if ((fabs(e) > MRB_AL_CLOCK_RESYNC_THRESHOLD) || (dt <= 0.0)) {
+    mrb_al_clock_restart(data, now, media);
+    return;
+  }
+  double w = 2.0 * M_PI * data->bandwidth * dt;
+  w = (w < 0.5) ? w : 0.5;
+  double rate = data->rate + w * w * e / dt;
+  rate = (rate < 0.5) ? 0.5 : ((rate > 2.0) ? 2.0 : rate);
+  data->host_base = now;
+  data->media_base = predicted + 1.41421356237309504880 * w * e;
+  data->rate = rate;
+}
+
+/*
+ * AL::Clock.new(source[, interval = 0.02[, bandwidth = 0.5[, context]]])
+ * 'source' is a Source, or an AL::Stream or AL::StreamingSource to follow
+ * a queued stream across unqueues.
+ * 'context' is the ALC::Context the source belongs to. with it the device
+ * clock is used where ALC_SOFT_device_clock is present; without it, or once
+ * the context is destroyed or its device closed, only source offsets are.
+ */
+static mrb_value
+mrb_al_clock_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)DATA_PTR(self);
+  mrb_value source;
+  mrb_float interval = 0.02;
+  mrb_float bandwidth = 0.5;
+  mrb_value context = mrb_nil_value();
+  mrb_get_args(mrb, "o|ffo", &source, &interval, &bandwidth, &context);
+
+  if ((interval < 0.0) || (bandwidth <= 0.0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "invalid clock parameter is supplied.");
+  }
+  ALCdevice *device = NULL;
+  if (!mrb_nil_p(context)) {
+    device = mrb_alc_context_device(mrb, context);
+  }
+  ALuint source_name = 0;
+  mrb_al_clock_position_t position = NULL;
+  double offset, latency;
+  bool exact;
+  if (mrb_al_stream_position(source, &source_name, &offset, &latency, &exact)) {
+    position = mrb_al_stream_position;
+  } else if (mrb_al_streaming_source_position(source, &source_name, &offset, &latency, &exact)) {
+    position = mrb_al_streaming_source_position;
+  } else {
+    source_name = mrb_al_source_name(mrb, source);
+  }
+
+  if (NULL != data) {
+    mrb_al_clock_free(mrb, data);
+  }
+  data = (mrb_al_clock_data_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_clock_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->source = source_name;
+  data->position = position;
+  if ((NULL != device) && alcIsExtensionPresent(device, "ALC_SOFT_device_clock")) {
+    data->get_integer64v = (mrb_alc_get_integer64v_t)alcGetProcAddress(device, "alcGetInteger64vSOFT");
+  }
+  data->interval = interval;
+  data->bandwidth = bandwidth;
+  data->rate = 1.0;
+
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_clock_data_type;
+
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@source", 7), source);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@context", 8), context);
+
+  return self;
+}
+
+/* seconds of the source that have been heard. never decreases while playing. */
+static mrb_value
+mrb_al_clock_get_time(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  double const now = mrb_al_clock_now();
+  if (!data->sampled || (now - data->last_sample >= data->interval)) {
+    mrb_al_clock_sample(mrb, self, data, now);
+  }
+  if (!data->running) {
+    return mrb_float_value(mrb, data->media_base);
+  }
+  double t = data->media_base + data->rate * (now - data->host_base);
+  t = (t < data->last_time) ? data->last_time : t;
+  data->last_time = t;
+  return mrb_float_value(mrb, t);
+}
+
+static mrb_value
+mrb_al_clock_update(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  mrb_al_clock_sample(mrb, self, data, mrb_al_clock_now());
+  return self;
+}
+
+/* drops the loop state, e.g. after seeking the source. */
+static mrb_value
+mrb_al_clock_reset(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  data->running = false;
+  data->sampled = false;
+  data->device_clock = 0;
+  return self;
+}
+
+static mrb_value
+mrb_al_clock_get_rate(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  return mrb_float_value(mrb, data->running ? data->rate : 0.0);
+}
+
+static mrb_value
+mrb_al_clock_get_latency(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  return mrb_float_value(mrb, data->latency);
+}
+
+static mrb_value
+mrb_al_clock_is_running(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  return data->running ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_clock_has_device_clock(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  return (NULL != data->get_integer64v) ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_clock_get_interval(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  return mrb_float_value(mrb, data->interval);
+}
+
+static mrb_value
+mrb_al_clock_set_interval(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_clock_data_t *data =
+    (mrb_al_clock_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_clock_data_type);
+  mrb_float value;
+  mrb_get_args(mrb, "f", &value);
+  if (value < 0.0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "interval must not be negative.");
+  }
+  data->interval = value;
+  return mrb_float_value(mrb, value);
+}
+
+static mrb_value
+mrb_al_clock_get_source(mrb_state *mrb, mrb_value self)
+{
+  return mrb_iv_get(mrb, self, mrb_intern(mrb, "@source", 7));
+}
+
+void
+mruby_openal_clock_init(mrb_state *mrb)
+{
+  class_Clock = mrb_define_class_under(mrb, mod_AL, "Clock", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_Clock, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_Clock, "initialize",    mrb_al_clock_initialize,       ARGS_REQ(1) | ARGS_OPT(3));
+  mrb_define_method(mrb, class_Clock, "time",          mrb_al_clock_get_time,         ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "update",        mrb_al_clock_update,           ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "reset",         mrb_al_clock_reset,            ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "rate",          mrb_al_clock_get_rate,         ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "latency",       mrb_al_clock_get_latency,      ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "running?",      mrb_al_clock_is_running,       ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "device_clock?", mrb_al_clock_has_device_clock, ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "interval",      mrb_al_clock_get_interval,     ARGS_NONE());
+  mrb_define_method(mrb, class_Clock, "interval=",     mrb_al_clock_set_interval,     ARGS_REQ(1));
+  mrb_define_method(mrb, class_Clock, "source",        mrb_al_clock_get_source,       ARGS_NONE());
+}
+
+void
+mruby_openal_clock_final(mrb_state *mrb)
+{
+}
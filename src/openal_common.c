@@ -1,7 +1,210 @@
 #include "openal.h"
 #include "mruby/class.h"
+#include "mruby/array.h"
+#include "mruby/string.h"
+#include "mruby/variable.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
-static struct RClass *class_SampleBuffer = NULL;
+#ifdef RSTR_EMBED_P
+#define MRB_AL_RSTR_HEAP(s) ((s)->as.heap)
+#else
+#define MRB_AL_RSTR_HEAP(s) (*(s))
+#endif
+
+/* storage Strings are at least this long, which keeps them off the embedded representation. */
+#define MRB_AL_SAMPLE_STORAGE_MIN 64
+
+struct RClass *class_SampleBuffer = NULL;
+
+size_t
+mrb_al_format_frame_size(ALenum format)
+{
+  switch (format) {
+  case AL_FORMAT_MONO8:
+    return 1;
+  case AL_FORMAT_MONO16:
+    return 2;
+  case AL_FORMAT_STEREO8:
+    return 2;
+  case AL_FORMAT_STEREO16:
+    return 4;
+  case AL_FORMAT_MONO_FLOAT32:
+    return 4;
+  case AL_FORMAT_STEREO_FLOAT32:
+    return 8;
+  default:
+    return 0;
+  }
+}
+
+static uint32_t
+read_le32(unsigned char const *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t
+read_le16(unsigned char const *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*
+ * locates the PCM payload of a RIFF/WAVE image in place.
+ * returns NULL on success, or an error message.
+ */
+char const*
+mrb_al_parse_wave(unsigned char const *image, size_t size, ALenum *format, ALsizei *frequency, unsigned char const **pcm, size_t *pcm_size)
+{
+  if ((size < 12) || (0 != memcmp(image, "RIFF", 4)) || (0 != memcmp(image + 8, "WAVE", 4))) {
+    return "not a RIFF/WAVE file.";
+  }
+  bool has_format = false;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    unsigned char const *chunk = image + offset;
+    size_t const chunk_size = read_le32(chunk + 4);
+    size_t const body = offset + 8;
+    if (chunk_size > size - body) {
+      return "truncated chunk is found.";
+    }
+    if (0 == memcmp(chunk, "fmt ", 4)) {
+      if (chunk_size < 16) {
+        return "broken fmt chunk is found.";
+      }
+      uint16_t const tag = read_le16(image + body);
+      uint16_t const channels = read_le16(image + body + 2);
+      uint16_t const bits = read_le16(image + body + 14);
+      if (1 != tag) {
+        return "only linear PCM is supported.";
+      }
+      if ((1 == channels) && (8 == bits)) {
+        *format = AL_FORMAT_MONO8;
+      } else if ((1 == channels) && (16 == bits)) {
+        *format = AL_FORMAT_MONO16;
+      } else if ((2 == channels) && (8 == bits)) {
+        *format = AL_FORMAT_STEREO8;
+      } else if ((2 == channels) && (16 == bits)) {
+        *format = AL_FORMAT_STEREO16;
+      } else {
+        return "unsupported channel count or sample width.";
+      }
+      *frequency = (ALsizei)read_le32(image + body + 4);
+      has_format = true;
+    } else if (0 == memcmp(chunk, "data", 4)) {
+      if (!has_format) {
+        return "data chunk precedes fmt chunk.";
+      }
+      *pcm = image + body;
+      *pcm_size = chunk_size;
+      return NULL;
+    }
+    offset = body + chunk_size + (chunk_size & 1);
+  }
+  return "no data chunk is found.";
+}
+
+mrb_al_sample_block_t*
+mrb_al_sample_block_new(mrb_state *mrb, size_t capacity)
+{
+  mrb_al_sample_block_t *block =
+    (mrb_al_sample_block_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_block_t) + capacity);
+  if (NULL == block) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  block->refs = 1;
+  block->capacity = capacity;
+  block->pool = NULL;
+  block->external = NULL;
+  return block;
+}
+
+void
+mrb_al_sample_block_release(mrb_state *mrb, mrb_al_sample_block_t *block)
+{
+  if ((NULL != block) && (0 == --block->refs)) {
+    if (NULL != block->pool) {
+      mrb_al_sample_pool_put(mrb, block->pool, block);
+    } else {
+      mrb_free(mrb, block);
+    }
+  }
+}
+
+/*
+ * a block whose bytes are the heap buffer of 'storage'. the String is set
+ * as @storage of 'self' and owns the bytes, so Strings shared from it by
+ * to_s keep them alive after every SampleBuffer is gone.
+ * the length of 'storage' must equal its capacity: making it shared then
+ * never reallocates the buffer under the block.
+ */
+static mrb_al_sample_block_t*
+mrb_al_sample_block_adopt_string(mrb_state *mrb, mrb_value self, mrb_value storage, size_t capacity)
+{
+  mrb_al_sample_block_t *block =
+    (mrb_al_sample_block_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_block_t));
+  if (NULL == block) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  block->refs = 1;
+  block->capacity = capacity;
+  block->pool = NULL;
+  block->external = RSTRING_PTR(storage);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@storage", 8), storage);
+  return block;
+}
+
+static mrb_al_sample_block_t*
+mrb_al_sample_block_new_string(mrb_state *mrb, mrb_value self, size_t capacity)
+{
+  size_t const size = (capacity < MRB_AL_SAMPLE_STORAGE_MIN) ? MRB_AL_SAMPLE_STORAGE_MIN : capacity;
+  return mrb_al_sample_block_adopt_string(mrb, self, mrb_str_new(mrb, NULL, size), capacity);
+}
+
+/* replaces the storage of 'data' with the whole of 'block'. the contents are not copied. */
+void
+mrb_al_sample_buffer_set_block(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, mrb_al_sample_block_t *block)
+{
+  mrb_al_sample_block_release(mrb, data->block);
+  data->block = block;
+  data->buffer = (NULL != block->external) ? block->external : (void*)block->bytes;
+  data->capacity = block->capacity;
+  if (data->size > data->capacity) {
+    data->size = data->capacity;
+  }
+}
+
+/*
+ * grows the capacity to at least 'capacity' bytes keeping the contents.
+ * storage shared with views or carved from a pool is copied instead, which
+ * detaches this buffer from them.
+ */
+void
+mrb_al_sample_buffer_reserve(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, size_t capacity)
+{
+  if (capacity <= data->capacity) {
+    return;
+  }
+  mrb_al_sample_block_t *block = data->block;
+  if ((NULL != block) && (NULL == block->pool) && (NULL == block->external) && (1 == block->refs) && (data->buffer == (void*)block->bytes)) {
+    block = (mrb_al_sample_block_t*)mrb_realloc(mrb, block, sizeof(mrb_al_sample_block_t) + capacity);
+    if (NULL == block) {
+      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+    }
+    block->capacity = capacity;
+    data->block = block;
+    data->buffer = block->bytes;
+    data->capacity = capacity;
+    return;
+  }
+  block = mrb_al_sample_block_new(mrb, capacity);
+  if (0 < data->size) {
+    memcpy(block->bytes, data->buffer, data->size);
+  }
+  mrb_al_sample_buffer_set_block(mrb, data, block);
+}
 
 static void
 mrb_al_sample_buffer_free(mrb_state *mrb, void *p)
@@ -9,8 +212,13 @@ mrb_al_sample_buffer_free(mrb_state *mrb, void *p)
   mrb_al_sample_buffer_data_t *data =
     (mrb_al_sample_buffer_data_t*)p;
   if (NULL != data) {
-    mrb_free(mrb, data->buffer);
-    mrb_free(mrb, data);
+    mrb_al_sample_block_t *slot = data->slot;
+    mrb_al_sample_block_release(mrb, data->block);
+    if (NULL != slot) {
+      mrb_al_sample_block_release(mrb, slot);
+    } else {
+      mrb_free(mrb, data);
+    }
   }
 }
 
@@ -24,52 +232,503 @@ mrb_al_samplebuffer_initialize(mrb_state *mrb, mrb_value self)
   mrb_int capacity;
   mrb_get_args(mrb, "i", &capacity);
 
+  if (capacity < 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "capacity must not be negative.");
+  }
   if (NULL == data) {
     data = (mrb_al_sample_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_buffer_data_t));
     if (NULL == data) {
       mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
     }
     data->buffer = NULL;
-    data->capacity = capacity;
+    data->capacity = 0;
     data->size = 0;
+    data->block = NULL;
+    data->slot = NULL;
+    DATA_PTR(self) = data;
+    DATA_TYPE(self) = &mrb_al_sample_buffer_data_type;
   }
 
-  if ((data->capacity != capacity) && (NULL != data->buffer)) {
-    void *buffer = mrb_realloc(mrb, data->buffer, capacity);
-    if (NULL == buffer) {
-      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  data->size = 0;
+  mrb_al_sample_buffer_set_block(mrb, data, mrb_al_sample_block_new_string(mrb, self, (size_t)capacity));
+
+  return self;
+}
+
+static mrb_value
+mrb_al_samplebuffer_get_capacity(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  return mrb_fixnum_value(data->capacity);
+}
+
+static mrb_value
+mrb_al_samplebuffer_get_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  return mrb_fixnum_value(data->size);
+}
+
+static mrb_value
+mrb_al_samplebuffer_clear(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  data->size = 0;
+  return self;
+}
+
+static mrb_value
+mrb_al_samplebuffer_reserve(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int capacity;
+  mrb_get_args(mrb, "i", &capacity);
+  if (capacity < 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "capacity must not be negative.");
+  }
+  mrb_al_sample_buffer_reserve(mrb, data, (size_t)capacity);
+  return self;
+}
+
+/* appends a SampleBuffer or String, doubling the capacity as needed. */
+static mrb_value
+mrb_al_samplebuffer_append(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_value other;
+  mrb_get_args(mrb, "o", &other);
+
+  mrb_al_sample_buffer_data_t *other_data = NULL;
+  size_t length;
+  if (mrb_string_p(other)) {
+    length = RSTRING_LEN(other);
+  } else {
+    other_data =
+      (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, other, &mrb_al_sample_buffer_data_type);
+    length = other_data->size;
+  }
+  size_t const required = data->size + length;
+  if (required > data->capacity) {
+    size_t capacity = (0 < data->capacity) ? data->capacity : 64;
+    while (capacity < required) {
+      capacity *= 2;
     }
-    data->buffer = buffer;
+    mrb_al_sample_buffer_reserve(mrb, data, capacity);
+  }
+  /* fetched after reserving, since appending to itself may have moved the source. */
+  void const *src = (NULL != other_data) ? other_data->buffer : (void const*)RSTRING_PTR(other);
+  memmove((unsigned char*)data->buffer + data->size, src, length);
+  data->size = required;
+  return self;
+}
+
+static void
+mrb_al_samplebuffer_get_range(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, mrb_int *offset, mrb_int *length)
+{
+  mrb_get_args(mrb, "ii", offset, length);
+  if ((*offset < 0) || (*length < 0) || ((size_t)*offset > data->size) || ((size_t)*length > data->size - (size_t)*offset)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "range is out of buffer.");
+  }
+}
+
+/*
+ * returns a SampleBuffer aliasing bytes [offset, offset + length) without copying.
+ * it shares the storage by reference count, so it stays valid after the
+ * parent is collected; growing either side detaches it from the other.
+ */
+static mrb_value
+mrb_al_samplebuffer_view(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int offset, length;
+  mrb_al_samplebuffer_get_range(mrb, data, &offset, &length);
+
+  mrb_al_sample_buffer_data_t *view =
+    (mrb_al_sample_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_buffer_data_t));
+  if (NULL == view) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  view->buffer = (unsigned char*)data->buffer + offset;
+  view->capacity = (size_t)length;
+  view->size = (size_t)length;
+  view->block = data->block;
+  view->slot = NULL;
+  if (NULL != view->block) {
+    ++view->block->refs;
+  }
+  mrb_value const obj = mrb_obj_value(Data_Wrap_Struct(mrb, class_SampleBuffer, &mrb_al_sample_buffer_data_type, view));
+  /* the view needs the owner of string-backed bytes as much as the parent does. */
+  mrb_sym const storage = mrb_intern(mrb, "@storage", 8);
+  mrb_iv_set(mrb, obj, storage, mrb_iv_get(mrb, self, storage));
+  return obj;
+}
+
+/*
+ * returns a frozen String sharing the valid bytes with this buffer, so
+ * later writes to the buffer show through it. the bytes belong to the
+ * @storage String, which the result keeps alive on its own.
+ * storage that was reallocated by a grow moves into a String once here.
+ * pooled storage returns to its pool and storage shared with views must
+ * stay where they see it, so those two are copied instead.
+ */
+static mrb_value
+mrb_al_samplebuffer_to_s(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_al_sample_block_t *block = data->block;
+  if ((NULL == block) || (NULL != block->pool) || ((NULL == block->external) && (1 != block->refs))) {
+    return mrb_str_new(mrb, (char const*)data->buffer, data->size);
+  }
+  if (NULL == block->external) {
+    block = mrb_al_sample_block_new_string(mrb, self, data->capacity);
+    memcpy(block->external, data->buffer, data->size);
+    mrb_al_sample_buffer_set_block(mrb, data, block);
+  }
+  mrb_value const storage = mrb_iv_get(mrb, self, mrb_intern(mrb, "@storage", 8));
+  mrb_value const str = mrb_str_substr(mrb, storage, (mrb_int)((char*)data->buffer - (char*)block->external), (mrb_int)data->size);
+#ifdef MRB_SET_FROZEN_FLAG
+  MRB_SET_FROZEN_FLAG(mrb_obj_ptr(str));
+#endif
+  return str;
+}
+
+/* copies [offset, offset + length) out, defaulting to all valid bytes. */
+static mrb_value
+mrb_al_samplebuffer_read(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int offset = 0;
+  mrb_int length = (mrb_int)data->size;
+  int const argc = mrb_get_args(mrb, "|ii", &offset, &length);
+  if (1 == argc) {
+    length = (mrb_int)data->size - offset;
+  }
+  if ((offset < 0) || (length < 0) || ((size_t)offset > data->size) || ((size_t)length > data->size - (size_t)offset)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "range is out of buffer.");
+  }
+  return mrb_str_new(mrb, (char const*)data->buffer + offset, (size_t)length);
+}
+
+/* copies a String in at 'offset' (default: the end), growing as needed. */
+static mrb_value
+mrb_al_samplebuffer_write(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_value str;
+  mrb_int offset = (mrb_int)data->size;
+  mrb_get_args(mrb, "S|i", &str, &offset);
+  if ((offset < 0) || ((size_t)offset > data->size)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "offset is out of buffer.");
+  }
+  size_t const end = (size_t)offset + RSTRING_LEN(str);
+  if (end > data->capacity) {
+    size_t capacity = (0 < data->capacity) ? data->capacity : 64;
+    while (capacity < end) {
+      capacity *= 2;
+    }
+    mrb_al_sample_buffer_reserve(mrb, data, capacity);
+  }
+  memcpy((unsigned char*)data->buffer + offset, RSTRING_PTR(str), RSTRING_LEN(str));
+  if (end > data->size) {
+    data->size = end;
+  }
+  return mrb_fixnum_value(RSTRING_LEN(str));
+}
+
+enum {
+  MRB_AL_ELEMENT_U8,
+  MRB_AL_ELEMENT_I16,
+  MRB_AL_ELEMENT_F32,
+};
+
+static size_t const element_sizes[] = { 1, 2, 4 };
+
+static int
+mrb_al_samplebuffer_get_element_type(mrb_state *mrb, mrb_sym type)
+{
+  if (type == mrb_intern(mrb, "u8", 2)) {
+    return MRB_AL_ELEMENT_U8;
+  } else if (type == mrb_intern(mrb, "i16", 3)) {
+    return MRB_AL_ELEMENT_I16;
+  } else if (type == mrb_intern(mrb, "f32", 3)) {
+    return MRB_AL_ELEMENT_F32;
+  }
+  mrb_raise(mrb, E_ARGUMENT_ERROR, "element type must be one of :u8, :i16 or :f32.");
+  return 0;
+}
+
+/* integer elements saturate; floats are stored as they are. */
+static void
+mrb_al_samplebuffer_store(mrb_state *mrb, void *dst, int type, mrb_value value)
+{
+  if (MRB_AL_ELEMENT_F32 == type) {
+    float v;
+    if (mrb_float_p(value)) {
+      v = (float)mrb_float(value);
+    } else if (mrb_fixnum_p(value)) {
+      v = (float)mrb_fixnum(value);
+    } else {
+      mrb_raise(mrb, E_TYPE_ERROR, "values must be numeric type.");
+      return;
+    }
+    memcpy(dst, &v, sizeof(v));
+    return;
+  }
+  if (!mrb_fixnum_p(value)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "values must be integer type.");
+  }
+  mrb_int const v = mrb_fixnum(value);
+  if (MRB_AL_ELEMENT_U8 == type) {
+    *(uint8_t*)dst = (uint8_t)((v < 0) ? 0 : ((v > UINT8_MAX) ? UINT8_MAX : v));
   } else {
-    data->buffer = mrb_malloc(mrb, capacity);
-    if (NULL == data->buffer) {
-      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+    int16_t const i = (int16_t)((v < INT16_MIN) ? INT16_MIN : ((v > INT16_MAX) ? INT16_MAX : v));
+    memcpy(dst, &i, sizeof(i));
+  }
+}
+
+static mrb_value
+mrb_al_samplebuffer_load(mrb_state *mrb, void const *src, int type)
+{
+  switch (type) {
+  case MRB_AL_ELEMENT_U8:
+    return mrb_fixnum_value(*(uint8_t const*)src);
+  case MRB_AL_ELEMENT_I16:
+    {
+      int16_t v;
+      memcpy(&v, src, sizeof(v));
+      return mrb_fixnum_value(v);
+    }
+  default:
+    {
+      float v;
+      memcpy(&v, src, sizeof(v));
+      return mrb_float_value(mrb, v);
     }
   }
+}
 
-  data->capacity = capacity;
-  data->size = 0;
+static mrb_value
+mrb_al_samplebuffer_get_element(mrb_state *mrb, mrb_value self, int type)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int index;
+  mrb_get_args(mrb, "i", &index);
+  if ((index < 0) || ((size_t)index >= data->size / element_sizes[type])) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  return mrb_al_samplebuffer_load(mrb, (unsigned char const*)data->buffer + index * element_sizes[type], type);
+}
 
-  DATA_PTR(self) = data;
-  DATA_TYPE(self) = &mrb_al_sample_buffer_data_type;
+/* writes inside the capacity, extending the size to cover the element. */
+static mrb_value
+mrb_al_samplebuffer_set_element(mrb_state *mrb, mrb_value self, int type)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int index;
+  mrb_value value;
+  mrb_get_args(mrb, "io", &index, &value);
+  if ((index < 0) || ((size_t)index >= data->capacity / element_sizes[type])) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  size_t const offset = (size_t)index * element_sizes[type];
+  mrb_al_samplebuffer_store(mrb, (unsigned char*)data->buffer + offset, type, value);
+  if (offset + element_sizes[type] > data->size) {
+    /* the gap up to the new element becomes valid, so it must not expose stale bytes. */
+    if (offset > data->size) {
+      memset((unsigned char*)data->buffer + data->size, 0, offset - data->size);
+    }
+    data->size = offset + element_sizes[type];
+  }
+  return value;
+}
+
+static mrb_value
+mrb_al_samplebuffer_get_u8(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_get_element(mrb, self, MRB_AL_ELEMENT_U8);
+}
+
+static mrb_value
+mrb_al_samplebuffer_set_u8(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_set_element(mrb, self, MRB_AL_ELEMENT_U8);
+}
+
+static mrb_value
+mrb_al_samplebuffer_get_i16(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_get_element(mrb, self, MRB_AL_ELEMENT_I16);
+}
+
+static mrb_value
+mrb_al_samplebuffer_set_i16(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_set_element(mrb, self, MRB_AL_ELEMENT_I16);
+}
+
+static mrb_value
+mrb_al_samplebuffer_get_f32(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_get_element(mrb, self, MRB_AL_ELEMENT_F32);
+}
+
+static mrb_value
+mrb_al_samplebuffer_set_f32(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_set_element(mrb, self, MRB_AL_ELEMENT_F32);
+}
+
+/*
+ * fill_from_array(type, values[, index = 0]) stores 'values' as elements
+ * starting at 'index', growing the buffer once if needed.
+ */
+static mrb_value
+mrb_al_samplebuffer_fill_from_array(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_sym type_name;
+  mrb_value values;
+  mrb_int index = 0;
+  mrb_get_args(mrb, "nA|i", &type_name, &values, &index);
+  int const type = mrb_al_samplebuffer_get_element_type(mrb, type_name);
+  size_t const element_size = element_sizes[type];
+  if ((index < 0) || ((size_t)index > data->size / element_size)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  mrb_int const count = RARRAY_LEN(values);
+  size_t const end = ((size_t)index + count) * element_size;
+  mrb_al_sample_buffer_reserve(mrb, data, end);
 
+  mrb_value const *ptr = RARRAY_PTR(values);
+  unsigned char *dst = (unsigned char*)data->buffer + index * element_size;
+  mrb_int i;
+  for (i = 0; i < count; ++i) {
+    mrb_al_samplebuffer_store(mrb, dst + i * element_size, type, ptr[i]);
+  }
+  if (end > data->size) {
+    data->size = end;
+  }
   return self;
 }
 
+/* to_array(type[, index = 0, count]) returns elements as an Array. */
 static mrb_value
-mrb_al_samplebuffer_get_capacity(mrb_state *mrb, mrb_value self)
+mrb_al_samplebuffer_to_array(mrb_state *mrb, mrb_value self)
 {
   mrb_al_sample_buffer_data_t *data =
     (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
-  return mrb_fixnum_value(data->capacity);
+  mrb_sym type_name;
+  mrb_int index = 0;
+  mrb_int count = -1;
+  mrb_get_args(mrb, "n|ii", &type_name, &index, &count);
+  int const type = mrb_al_samplebuffer_get_element_type(mrb, type_name);
+  size_t const element_size = element_sizes[type];
+  size_t const total = data->size / element_size;
+  if ((index < 0) || ((size_t)index > total)) {
+    mrb_raise(mrb, E_INDEX_ERROR, "index is out of buffer.");
+  }
+  if (count < 0) {
+    count = (mrb_int)(total - (size_t)index);
+  } else if ((size_t)count > total - (size_t)index) {
+    mrb_raise(mrb, E_INDEX_ERROR, "count is out of buffer.");
+  }
+
+  mrb_value const ary = mrb_ary_new_capa(mrb, count);
+  unsigned char const *src = (unsigned char const*)data->buffer + index * element_size;
+  int const ai = mrb_gc_arena_save(mrb);
+  mrb_int i;
+  for (i = 0; i < count; ++i) {
+    mrb_ary_push(mrb, ary, mrb_al_samplebuffer_load(mrb, src + i * element_size, type));
+    mrb_gc_arena_restore(mrb, ai);
+  }
+  return ary;
 }
 
+/*
+ * SampleBuffer.adopt(str) takes over the heap buffer of 'str' without
+ * copying. 'str' is left empty. bytes embedded in the String object itself
+ * cannot be taken over, so those are copied.
+ */
 static mrb_value
-mrb_al_samplebuffer_get_size(mrb_state *mrb, mrb_value self)
+mrb_al_samplebuffer_s_adopt(mrb_state *mrb, mrb_value klass)
+{
+  mrb_value str;
+  mrb_get_args(mrb, "S", &str);
+  struct RString *s = RSTRING(str);
+  /* makes the buffer private to 's', copying only if it was shared or static. */
+  mrb_str_modify(mrb, s);
+
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_buffer_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->buffer = NULL;
+  data->capacity = 0;
+  data->size = 0;
+  data->block = NULL;
+  data->slot = NULL;
+  mrb_value self = mrb_obj_value(Data_Wrap_Struct(mrb, class_SampleBuffer, &mrb_al_sample_buffer_data_type, data));
+
+#ifdef RSTR_EMBED_P
+  if (RSTR_EMBED_P(s)) {
+    size_t const size = (size_t)RSTRING_LEN(str);
+    mrb_al_sample_buffer_set_block(mrb, data, mrb_al_sample_block_new_string(mrb, self, size));
+    memcpy(data->buffer, RSTRING_PTR(str), size);
+    data->size = size;
+    mrb_str_resize(mrb, str, 0);
+    return self;
+  }
+#endif
+
+  /* swaps heap buffers with a fresh String, which becomes the storage. */
+  mrb_value const storage = mrb_str_new(mrb, NULL, MRB_AL_SAMPLE_STORAGE_MIN);
+  struct RString *t = RSTRING(storage);
+  char *spare = MRB_AL_RSTR_HEAP(t).ptr;
+  mrb_int const spare_capa = MRB_AL_RSTR_HEAP(t).aux.capa;
+  mrb_int const size = MRB_AL_RSTR_HEAP(s).len;
+  mrb_int const capa = MRB_AL_RSTR_HEAP(s).aux.capa;
+  MRB_AL_RSTR_HEAP(t).ptr = MRB_AL_RSTR_HEAP(s).ptr;
+  MRB_AL_RSTR_HEAP(t).len = capa;
+  MRB_AL_RSTR_HEAP(t).aux.capa = capa;
+  MRB_AL_RSTR_HEAP(t).ptr[capa] = '\0';
+  spare[0] = '\0';
+  MRB_AL_RSTR_HEAP(s).ptr = spare;
+  MRB_AL_RSTR_HEAP(s).len = 0;
+  MRB_AL_RSTR_HEAP(s).aux.capa = spare_capa;
+
+  mrb_al_sample_buffer_set_block(mrb, data, mrb_al_sample_block_adopt_string(mrb, self, storage, (size_t)capa));
+  data->size = (size_t)size;
+  return self;
+}
+
+static mrb_value
+mrb_al_samplebuffer_slice(mrb_state *mrb, mrb_value self)
 {
   mrb_al_sample_buffer_data_t *data =
     (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
-  return mrb_fixnum_value(data->size);
+  mrb_int offset, length;
+  mrb_al_samplebuffer_get_range(mrb, data, &offset, &length);
+
+  mrb_value arg = mrb_fixnum_value(length);
+  mrb_value const slice = mrb_obj_new(mrb, class_SampleBuffer, 1, &arg);
+  mrb_al_sample_buffer_data_t *slice_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, slice, &mrb_al_sample_buffer_data_type);
+  memcpy(slice_data->buffer, (unsigned char const*)data->buffer + offset, (size_t)length);
+  slice_data->size = (size_t)length;
+  return slice;
 }
 
 void
@@ -79,9 +738,28 @@ mruby_openal_common_init(mrb_state *mrb)
 
   MRB_SET_INSTANCE_TT(class_SampleBuffer, MRB_TT_DATA);
 
+  mrb_define_class_method(mrb, class_SampleBuffer, "adopt", mrb_al_samplebuffer_s_adopt, ARGS_REQ(1));
+
   mrb_define_method(mrb, class_SampleBuffer, "initialize", mrb_al_samplebuffer_initialize,   ARGS_REQ(1));
   mrb_define_method(mrb, class_SampleBuffer, "capacity",   mrb_al_samplebuffer_get_capacity, ARGS_NONE());
   mrb_define_method(mrb, class_SampleBuffer, "size",       mrb_al_samplebuffer_get_size,     ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBuffer, "clear",      mrb_al_samplebuffer_clear,        ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBuffer, "reserve",    mrb_al_samplebuffer_reserve,      ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "append",     mrb_al_samplebuffer_append,       ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "<<",         mrb_al_samplebuffer_append,       ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "view",       mrb_al_samplebuffer_view,         ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "slice",      mrb_al_samplebuffer_slice,        ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "to_s",       mrb_al_samplebuffer_to_s,         ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBuffer, "read",       mrb_al_samplebuffer_read,         ARGS_OPT(2));
+  mrb_define_method(mrb, class_SampleBuffer, "write",      mrb_al_samplebuffer_write,        ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "get_u8",     mrb_al_samplebuffer_get_u8,       ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "set_u8",     mrb_al_samplebuffer_set_u8,       ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "get_i16",    mrb_al_samplebuffer_get_i16,      ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "set_i16",    mrb_al_samplebuffer_set_i16,      ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "get_f32",    mrb_al_samplebuffer_get_f32,      ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "set_f32",    mrb_al_samplebuffer_set_f32,      ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "fill_from_array", mrb_al_samplebuffer_fill_from_array, ARGS_REQ(2) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "to_array",   mrb_al_samplebuffer_to_array,     ARGS_REQ(1) | ARGS_OPT(2));
 }
 
 void
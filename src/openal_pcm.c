@@ -0,0 +1,994 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MRB_AL_PCM_X86
+#include <immintrin.h>
+#define MRB_AL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* frames converted per pass through the float scratch. */
+#define MRB_AL_PCM_BLOCK 512
+
+typedef struct mrb_al_pcm_kernels_t {
+  char const *name;
+  void (*u8_to_f32)(float *dst, uint8_t const *src, size_t count);
+  void (*s16_to_f32)(float *dst, int16_t const *src, size_t count);
+  void (*f32_to_u8)(uint8_t *dst, float const *src, size_t count);
+  void (*f32_to_s16)(int16_t *dst, float const *src, size_t count);
+  void (*downmix)(float *dst, float const *src, size_t frames);
+  void (*upmix)(float *dst, float const *src, size_t frames);
+  void (*interleave_s16)(int16_t *dst, int16_t const *left, int16_t const *right, size_t frames);
+  void (*deinterleave_s16)(int16_t *left, int16_t *right, int16_t const *src, size_t frames);
+  float (*dot)(float const *a, float const *b, size_t count);
+  void (*scale)(float *dst, float gain, size_t count);
+  void (*mix)(float *dst, float const *src, float gain, size_t count);
+  void (*clip)(float *dst, size_t count);
+  float (*peak)(float const *src, size_t count);
+} mrb_al_pcm_kernels_t;
+
+/*
+ * scalar kernels. s16 maps to [-1, 1) by 1/32768 and u8 by 1/128 around 128,
+ * so u8 <-> s16 through float is exact.
+ */
+static void
+scalar_u8_to_f32(float *dst, uint8_t const *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    dst[i] = ((int)src[i] - 128) * (1.0f / 128.0f);
+  }
+}
+
+static void
+scalar_s16_to_f32(float *dst, int16_t const *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    dst[i] = src[i] * (1.0f / 32768.0f);
+  }
+}
+
+static void
+scalar_f32_to_u8(uint8_t *dst, float const *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    float v = src[i] * 128.0f;
+    v = (v < -128.0f) ? -128.0f : ((v > 127.0f) ? 127.0f : v);
+    dst[i] = (uint8_t)(lrintf(v) + 128);
+  }
+}
+
+static void
+scalar_f32_to_s16(int16_t *dst, float const *src, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    float v = src[i] * 32768.0f;
+    v = (v < -32768.0f) ? -32768.0f : ((v > 32767.0f) ? 32767.0f : v);
+    dst[i] = (int16_t)lrintf(v);
+  }
+}
+
+static void
+scalar_downmix(float *dst, float const *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i < frames; ++i) {
+    dst[i] = (src[i * 2] + src[i * 2 + 1]) * 0.5f;
+  }
+}
+
+static void
+scalar_upmix(float *dst, float const *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i < frames; ++i) {
+    dst[i * 2] = dst[i * 2 + 1] = src[i];
+  }
+}
+
+static void
+scalar_interleave_s16(int16_t *dst, int16_t const *left, int16_t const *right, size_t frames)
+{
+  size_t i;
+  for (i = 0; i < frames; ++i) {
+    dst[i * 2] = left[i];
+    dst[i * 2 + 1] = right[i];
+  }
+}
+
+static void
+scalar_deinterleave_s16(int16_t *left, int16_t *right, int16_t const *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i < frames; ++i) {
+    left[i] = src[i * 2];
+    right[i] = src[i * 2 + 1];
+  }
+}
+
+static float
+scalar_dot(float const *a, float const *b, size_t count)
+{
+  float sum = 0.0f;
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+static void
+scalar_scale(float *dst, float gain, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    dst[i] *= gain;
+  }
+}
+
+static void
+scalar_mix(float *dst, float const *src, float gain, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+static void
+scalar_clip(float *dst, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    float const v = dst[i];
+    dst[i] = (v < -1.0f) ? -1.0f : ((v > 1.0f) ? 1.0f : v);
+  }
+}
+
+static float
+scalar_peak(float const *src, size_t count)
+{
+  float peak = 0.0f;
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    float const v = fabsf(src[i]);
+    peak = (v > peak) ? v : peak;
+  }
+  return peak;
+}
+
+static mrb_al_pcm_kernels_t const scalar_kernels = {
+  "scalar",
+  scalar_u8_to_f32, scalar_s16_to_f32, scalar_f32_to_u8, scalar_f32_to_s16,
+  scalar_downmix, scalar_upmix, scalar_interleave_s16, scalar_deinterleave_s16,
+  scalar_dot, scalar_scale, scalar_mix, scalar_clip, scalar_peak,
+};
+
+#ifdef MRB_AL_PCM_X86
+/*
+ * vector kernels. each handles the bulk and leaves the tail to the scalar one.
+ * stores never run ahead of loads, so narrowing conversions may work in place.
+ */
+MRB_AL_TARGET("sse2") static void
+sse2_u8_to_f32(float *dst, uint8_t const *src, size_t count)
+{
+  __m128i const zero = _mm_setzero_si128();
+  __m128i const bias = _mm_set1_epi16(128);
+  __m128 const scale = _mm_set1_ps(1.0f / 128.0f);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m128i const v = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i const*)(src + i)), zero), bias);
+    __m128i const lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i const hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  scalar_u8_to_f32(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_s16_to_f32(float *dst, int16_t const *src, size_t count)
+{
+  __m128 const scale = _mm_set1_ps(1.0f / 32768.0f);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m128i const v = _mm_loadu_si128((__m128i const*)(src + i));
+    __m128i const lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+    __m128i const hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    _mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+  }
+  scalar_s16_to_f32(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_f32_to_u8(uint8_t *dst, float const *src, size_t count)
+{
+  __m128 const scale = _mm_set1_ps(128.0f);
+  __m128 const min = _mm_set1_ps(-128.0f);
+  __m128 const max = _mm_set1_ps(127.0f);
+  __m128i const bias = _mm_set1_epi32(128);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m128 const a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i),     scale), min), max);
+    __m128 const b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), min), max);
+    __m128i const s = _mm_packs_epi32(_mm_add_epi32(_mm_cvtps_epi32(a), bias), _mm_add_epi32(_mm_cvtps_epi32(b), bias));
+    _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(s, s));
+  }
+  scalar_f32_to_u8(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_f32_to_s16(int16_t *dst, float const *src, size_t count)
+{
+  __m128 const scale = _mm_set1_ps(32768.0f);
+  __m128 const min = _mm_set1_ps(-32768.0f);
+  __m128 const max = _mm_set1_ps(32767.0f);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m128 const a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i),     scale), min), max);
+    __m128 const b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), min), max);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+  }
+  scalar_f32_to_s16(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_downmix(float *dst, float const *src, size_t frames)
+{
+  __m128 const half = _mm_set1_ps(0.5f);
+  size_t i;
+  for (i = 0; i + 4 <= frames; i += 4) {
+    __m128 const a = _mm_loadu_ps(src + i * 2);
+    __m128 const b = _mm_loadu_ps(src + i * 2 + 4);
+    __m128 const left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 const right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+  }
+  scalar_downmix(dst + i, src + i * 2, frames - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_upmix(float *dst, float const *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i + 4 <= frames; i += 4) {
+    __m128 const v = _mm_loadu_ps(src + i);
+    _mm_storeu_ps(dst + i * 2,     _mm_unpacklo_ps(v, v));
+    _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(v, v));
+  }
+  scalar_upmix(dst + i * 2, src + i, frames - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_interleave_s16(int16_t *dst, int16_t const *left, int16_t const *right, size_t frames)
+{
+  size_t i;
+  for (i = 0; i + 8 <= frames; i += 8) {
+    __m128i const l = _mm_loadu_si128((__m128i const*)(left + i));
+    __m128i const r = _mm_loadu_si128((__m128i const*)(right + i));
+    _mm_storeu_si128((__m128i*)(dst + i * 2),     _mm_unpacklo_epi16(l, r));
+    _mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+  }
+  scalar_interleave_s16(dst + i * 2, left + i, right + i, frames - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_deinterleave_s16(int16_t *left, int16_t *right, int16_t const *src, size_t frames)
+{
+  size_t i;
+  for (i = 0; i + 8 <= frames; i += 8) {
+    __m128i const a = _mm_loadu_si128((__m128i const*)(src + i * 2));
+    __m128i const b = _mm_loadu_si128((__m128i const*)(src + i * 2 + 8));
+    __m128i const la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    __m128i const lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    _mm_storeu_si128((__m128i*)(left + i),  _mm_packs_epi32(la, lb));
+    _mm_storeu_si128((__m128i*)(right + i), _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+  }
+  scalar_deinterleave_s16(left + i, right + i, src + i * 2, frames - i);
+}
+
+MRB_AL_TARGET("sse2") static float
+sse2_dot(float const *a, float const *b, size_t count)
+{
+  __m128 sum0 = _mm_setzero_ps();
+  __m128 sum1 = _mm_setzero_ps();
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+  sum0 = _mm_add_ps(sum0, sum1);
+  sum0 = _mm_add_ps(sum0, _mm_movehl_ps(sum0, sum0));
+  sum0 = _mm_add_ss(sum0, _mm_shuffle_ps(sum0, sum0, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(sum0) + scalar_dot(a + i, b + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_scale(float *dst, float gain, size_t count)
+{
+  __m128 const g = _mm_set1_ps(gain);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(dst + i,     _mm_mul_ps(_mm_loadu_ps(dst + i),     g));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_loadu_ps(dst + i + 4), g));
+  }
+  scalar_scale(dst + i, gain, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_mix(float *dst, float const *src, float gain, size_t count)
+{
+  __m128 const g = _mm_set1_ps(gain);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(dst + i,     _mm_add_ps(_mm_loadu_ps(dst + i),     _mm_mul_ps(_mm_loadu_ps(src + i),     g)));
+    _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g)));
+  }
+  scalar_mix(dst + i, src + i, gain, count - i);
+}
+
+MRB_AL_TARGET("sse2") static void
+sse2_clip(float *dst, size_t count)
+{
+  __m128 const min = _mm_set1_ps(-1.0f);
+  __m128 const max = _mm_set1_ps(1.0f);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    _mm_storeu_ps(dst + i,     _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i),     min), max));
+    _mm_storeu_ps(dst + i + 4, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i + 4), min), max));
+  }
+  scalar_clip(dst + i, count - i);
+}
+
+MRB_AL_TARGET("sse2") static float
+sse2_peak(float const *src, size_t count)
+{
+  __m128 const mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 peak0 = _mm_setzero_ps();
+  __m128 peak1 = _mm_setzero_ps();
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    peak0 = _mm_max_ps(peak0, _mm_and_ps(_mm_loadu_ps(src + i),     mask));
+    peak1 = _mm_max_ps(peak1, _mm_and_ps(_mm_loadu_ps(src + i + 4), mask));
+  }
+  peak0 = _mm_max_ps(peak0, peak1);
+  peak0 = _mm_max_ps(peak0, _mm_movehl_ps(peak0, peak0));
+  peak0 = _mm_max_ss(peak0, _mm_shuffle_ps(peak0, peak0, _MM_SHUFFLE(1, 1, 1, 1)));
+  float const peak = _mm_cvtss_f32(peak0);
+  float const tail = scalar_peak(src + i, count - i);
+  return (tail > peak) ? tail : peak;
+}
+
+static mrb_al_pcm_kernels_t const sse2_kernels = {
+  "sse2",
+  sse2_u8_to_f32, sse2_s16_to_f32, sse2_f32_to_u8, sse2_f32_to_s16,
+  sse2_downmix, sse2_upmix, sse2_interleave_s16, sse2_deinterleave_s16,
+  sse2_dot, sse2_scale, sse2_mix, sse2_clip, sse2_peak,
+};
+
+MRB_AL_TARGET("avx2") static void
+avx2_u8_to_f32(float *dst, uint8_t const *src, size_t count)
+{
+  __m256i const bias = _mm256_set1_epi32(128);
+  __m256 const scale = _mm256_set1_ps(1.0f / 128.0f);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m256i const v = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(src + i))), bias);
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+  }
+  scalar_u8_to_f32(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_s16_to_f32(float *dst, int16_t const *src, size_t count)
+{
+  __m256 const scale = _mm256_set1_ps(1.0f / 32768.0f);
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    __m256i const lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const*)(src + i)));
+    __m256i const hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const*)(src + i + 8)));
+    _mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+  }
+  sse2_s16_to_f32(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_f32_to_s16(int16_t *dst, float const *src, size_t count)
+{
+  __m256 const scale = _mm256_set1_ps(32768.0f);
+  __m256 const min = _mm256_set1_ps(-32768.0f);
+  __m256 const max = _mm256_set1_ps(32767.0f);
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    __m256 const a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i),     scale), min), max);
+    __m256 const b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), min), max);
+    /* packs works per 128-bit lane, so put the 64-bit quarters back in order. */
+    __m256i const s = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  sse2_f32_to_s16(dst + i, src + i, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_downmix(float *dst, float const *src, size_t frames)
+{
+  __m256 const half = _mm256_set1_ps(0.5f);
+  size_t i;
+  for (i = 0; i + 8 <= frames; i += 8) {
+    __m256 const sum = _mm256_hadd_ps(_mm256_loadu_ps(src + i * 2), _mm256_loadu_ps(src + i * 2 + 8));
+    __m256 const ordered = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(ordered, half));
+  }
+  sse2_downmix(dst + i, src + i * 2, frames - i);
+}
+
+MRB_AL_TARGET("avx2") static float
+avx2_dot(float const *a, float const *b, size_t count)
+{
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(_mm256_loadu_ps(a + i),     _mm256_loadu_ps(b + i)));
+    sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+  }
+  sum0 = _mm256_add_ps(sum0, sum1);
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum0), _mm256_extractf128_ps(sum0, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+  return _mm_cvtss_f32(sum) + sse2_dot(a + i, b + i, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_scale(float *dst, float gain, size_t count)
+{
+  __m256 const g = _mm256_set1_ps(gain);
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    _mm256_storeu_ps(dst + i,     _mm256_mul_ps(_mm256_loadu_ps(dst + i),     g));
+    _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_loadu_ps(dst + i + 8), g));
+  }
+  sse2_scale(dst + i, gain, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_mix(float *dst, float const *src, float gain, size_t count)
+{
+  __m256 const g = _mm256_set1_ps(gain);
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    _mm256_storeu_ps(dst + i,     _mm256_add_ps(_mm256_loadu_ps(dst + i),     _mm256_mul_ps(_mm256_loadu_ps(src + i),     g)));
+    _mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), g)));
+  }
+  sse2_mix(dst + i, src + i, gain, count - i);
+}
+
+MRB_AL_TARGET("avx2") static void
+avx2_clip(float *dst, size_t count)
+{
+  __m256 const min = _mm256_set1_ps(-1.0f);
+  __m256 const max = _mm256_set1_ps(1.0f);
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    _mm256_storeu_ps(dst + i,     _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(dst + i),     min), max));
+    _mm256_storeu_ps(dst + i + 8, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(dst + i + 8), min), max));
+  }
+  sse2_clip(dst + i, count - i);
+}
+
+MRB_AL_TARGET("avx2") static float
+avx2_peak(float const *src, size_t count)
+{
+  __m256 const mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+  __m256 peak0 = _mm256_setzero_ps();
+  __m256 peak1 = _mm256_setzero_ps();
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    peak0 = _mm256_max_ps(peak0, _mm256_and_ps(_mm256_loadu_ps(src + i),     mask));
+    peak1 = _mm256_max_ps(peak1, _mm256_and_ps(_mm256_loadu_ps(src + i + 8), mask));
+  }
+  peak0 = _mm256_max_ps(peak0, peak1);
+  __m128 peak = _mm_max_ps(_mm256_castps256_ps128(peak0), _mm256_extractf128_ps(peak0, 1));
+  peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+  peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 1, 1, 1)));
+  float const head = _mm_cvtss_f32(peak);
+  float const tail = sse2_peak(src + i, count - i);
+  return (tail > head) ? tail : head;
+}
+
+static mrb_al_pcm_kernels_t const avx2_kernels = {
+  "avx2",
+  avx2_u8_to_f32, avx2_s16_to_f32, sse2_f32_to_u8, avx2_f32_to_s16,
+  avx2_downmix, sse2_upmix, sse2_interleave_s16, sse2_deinterleave_s16,
+  avx2_dot, avx2_scale, avx2_mix, avx2_clip, avx2_peak,
+};
+#endif
+
+static mrb_al_pcm_kernels_t const *kernels = &scalar_kernels;
+
+void
+mrb_al_pcm_get_format(mrb_state *mrb, mrb_int format, mrb_al_pcm_format_t *info)
+{
+  switch (format) {
+  case AL_FORMAT_MONO8:
+    info->type = MRB_AL_PCM_U8;  info->channels = 1; info->sample_size = 1;
+    break;
+  case AL_FORMAT_STEREO8:
+    info->type = MRB_AL_PCM_U8;  info->channels = 2; info->sample_size = 1;
+    break;
+  case AL_FORMAT_MONO16:
+    info->type = MRB_AL_PCM_S16; info->channels = 1; info->sample_size = 2;
+    break;
+  case AL_FORMAT_STEREO16:
+    info->type = MRB_AL_PCM_S16; info->channels = 2; info->sample_size = 2;
+    break;
+  case AL_FORMAT_MONO_FLOAT32:
+    info->type = MRB_AL_PCM_F32; info->channels = 1; info->sample_size = 4;
+    break;
+  case AL_FORMAT_STEREO_FLOAT32:
+    info->type = MRB_AL_PCM_F32; info->channels = 2; info->sample_size = 4;
+    break;
+  default:
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "unsupported format is specified.");
+  }
+}
+
+void
+mrb_al_pcm_decode(float *dst, void const *src, int type, size_t count)
+{
+  switch (type) {
+  case MRB_AL_PCM_U8:
+    kernels->u8_to_f32(dst, (uint8_t const*)src, count);
+    break;
+  case MRB_AL_PCM_S16:
+    kernels->s16_to_f32(dst, (int16_t const*)src, count);
+    break;
+  default:
+    memcpy(dst, src, count * sizeof(float));
+    break;
+  }
+}
+
+void
+mrb_al_pcm_encode(void *dst, float const *src, int type, size_t count)
+{
+  switch (type) {
+  case MRB_AL_PCM_U8:
+    kernels->f32_to_u8((uint8_t*)dst, src, count);
+    break;
+  case MRB_AL_PCM_S16:
+    kernels->f32_to_s16((int16_t*)dst, src, count);
+    break;
+  default:
+    memmove(dst, src, count * sizeof(float));
+    break;
+  }
+}
+
+float
+mrb_al_pcm_dot(float const *a, float const *b, size_t count)
+{
+  return kernels->dot(a, b, count);
+}
+
+/*
+ * converts 'frames' frames block by block through a float scratch.
+ * dst may alias src as long as a dst frame is not larger than a src frame.
+ */
+static void
+mrb_al_pcm_convert(void *dst, mrb_al_pcm_format_t const *to, void const *src, mrb_al_pcm_format_t const *from, size_t frames)
+{
+  size_t const src_frame_size = from->sample_size * from->channels;
+  size_t const dst_frame_size = to->sample_size * to->channels;
+  if ((from->type == to->type) && (from->channels == to->channels)) {
+    memmove(dst, src, frames * src_frame_size);
+    return;
+  }
+  float decoded[MRB_AL_PCM_BLOCK * 2];
+  float mixed[MRB_AL_PCM_BLOCK * 2];
+  size_t done;
+  for (done = 0; done < frames; ) {
+    size_t const n = (frames - done < MRB_AL_PCM_BLOCK) ? frames - done : MRB_AL_PCM_BLOCK;
+    unsigned char const *in = (unsigned char const*)src + done * src_frame_size;
+    unsigned char *out = (unsigned char*)dst + done * dst_frame_size;
+    float const *samples = (float const*)in;
+    if (MRB_AL_PCM_F32 != from->type) {
+      if ((from->channels == to->channels) && (MRB_AL_PCM_F32 == to->type)) {
+        mrb_al_pcm_decode((float*)out, in, from->type, n * from->channels);
+        done += n;
+        continue;
+      }
+      mrb_al_pcm_decode(decoded, in, from->type, n * from->channels);
+      samples = decoded;
+    }
+    if (from->channels > to->channels) {
+      kernels->downmix(mixed, samples, n);
+      samples = mixed;
+    } else if (from->channels < to->channels) {
+      kernels->upmix(mixed, samples, n);
+      samples = mixed;
+    }
+    mrb_al_pcm_encode(out, samples, to->type, n * to->channels);
+    done += n;
+  }
+}
+
+/* planar stereo keeps all left samples first, then all right samples. */
+static void
+mrb_al_pcm_interleave(void *dst, void const *src, mrb_al_pcm_format_t const *format, size_t frames, bool interleave)
+{
+  if (1 == format->channels) {
+    memcpy(dst, src, frames * format->sample_size);
+    return;
+  }
+  size_t const size = format->sample_size;
+  if (2 == size) {
+    if (interleave) {
+      kernels->interleave_s16((int16_t*)dst, (int16_t const*)src, (int16_t const*)src + frames, frames);
+    } else {
+      kernels->deinterleave_s16((int16_t*)dst, (int16_t*)dst + frames, (int16_t const*)src, frames);
+    }
+    return;
+  }
+  unsigned char *out = (unsigned char*)dst;
+  unsigned char const *in = (unsigned char const*)src;
+  size_t i;
+  for (i = 0; i < frames; ++i) {
+    if (interleave) {
+      memcpy(out + (i * 2) * size,     in + i * size,            size);
+      memcpy(out + (i * 2 + 1) * size, in + (frames + i) * size, size);
+    } else {
+      memcpy(out + i * size,            in + (i * 2) * size,     size);
+      memcpy(out + (frames + i) * size, in + (i * 2 + 1) * size, size);
+    }
+  }
+}
+
+static size_t
+mrb_al_pcm_frames(mrb_state *mrb, mrb_al_sample_buffer_data_t const *data, mrb_al_pcm_format_t const *format)
+{
+  size_t const frame_size = format->sample_size * format->channels;
+  if (0 != (data->size % frame_size)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "buffer size is not a multiple of the frame size.");
+  }
+  return data->size / frame_size;
+}
+
+/* returns the destination buffer, creating one when 'dst' is nil. */
+static mrb_al_sample_buffer_data_t*
+mrb_al_pcm_prepare_dst(mrb_state *mrb, mrb_value *dst, size_t size)
+{
+  if (mrb_nil_p(*dst)) {
+    mrb_value arg = mrb_fixnum_value((0 < size) ? size : 1);
+    *dst = mrb_obj_new(mrb, class_SampleBuffer, 1, &arg);
+  }
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, *dst, &mrb_al_sample_buffer_data_type);
+  if (data->capacity < size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "insufficient capacity.");
+  }
+  return data;
+}
+
+/* a fresh block for replacing the storage of 'data', holding at least 'size' bytes. */
+static mrb_al_sample_block_t*
+mrb_al_pcm_new_storage(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, size_t size)
+{
+  return mrb_al_sample_block_new(mrb, (data->capacity < size) ? size : data->capacity);
+}
+
+static void
+mrb_al_pcm_swap_storage(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, mrb_al_sample_block_t *block, size_t size)
+{
+  mrb_al_sample_buffer_set_block(mrb, data, block);
+  data->size = size;
+}
+
+static void
+mrb_al_pcm_convert_in_place(mrb_state *mrb, mrb_al_sample_buffer_data_t *data, mrb_al_pcm_format_t const *to, mrb_al_pcm_format_t const *from)
+{
+  size_t const frames = mrb_al_pcm_frames(mrb, data, from);
+  size_t const size = frames * to->sample_size * to->channels;
+  if (size <= data->size) {
+    mrb_al_pcm_convert(data->buffer, to, data->buffer, from, frames);
+    data->size = size;
+    return;
+  }
+  mrb_al_sample_block_t *block = mrb_al_pcm_new_storage(mrb, data, size);
+  mrb_al_pcm_convert(block->bytes, to, data->buffer, from, frames);
+  mrb_al_pcm_swap_storage(mrb, data, block, size);
+}
+
+/*
+ * converts between AL_FORMAT_* layouts, including sample type and
+ * mono/stereo changes. returns 'dst', or a new SampleBuffer if omitted.
+ */
+static mrb_value
+mrb_al_samplebuffer_convert(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int from_format, to_format;
+  mrb_value dst = mrb_nil_value();
+  mrb_get_args(mrb, "ii|o", &from_format, &to_format, &dst);
+  mrb_al_pcm_format_t from, to;
+  mrb_al_pcm_get_format(mrb, from_format, &from);
+  mrb_al_pcm_get_format(mrb, to_format, &to);
+
+  if (!mrb_nil_p(dst) && (mrb_obj_ptr(dst) == mrb_obj_ptr(self))) {
+    mrb_al_pcm_convert_in_place(mrb, data, &to, &from);
+    return self;
+  }
+  size_t const frames = mrb_al_pcm_frames(mrb, data, &from);
+  size_t const size = frames * to.sample_size * to.channels;
+  mrb_al_sample_buffer_data_t *dst_data = mrb_al_pcm_prepare_dst(mrb, &dst, size);
+  mrb_al_pcm_convert(dst_data->buffer, &to, data->buffer, &from, frames);
+  dst_data->size = size;
+  return dst;
+}
+
+static mrb_value
+mrb_al_samplebuffer_convert_bang(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int from_format, to_format;
+  mrb_get_args(mrb, "ii", &from_format, &to_format);
+  mrb_al_pcm_format_t from, to;
+  mrb_al_pcm_get_format(mrb, from_format, &from);
+  mrb_al_pcm_get_format(mrb, to_format, &to);
+  mrb_al_pcm_convert_in_place(mrb, data, &to, &from);
+  return self;
+}
+
+static mrb_value
+mrb_al_samplebuffer_reorder(mrb_state *mrb, mrb_value self, bool interleave, bool in_place)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_value dst = mrb_nil_value();
+  mrb_get_args(mrb, in_place ? "i" : "i|o", &format_value, &dst);
+  mrb_al_pcm_format_t format;
+  mrb_al_pcm_get_format(mrb, format_value, &format);
+  size_t const frames = mrb_al_pcm_frames(mrb, data, &format);
+
+  if (in_place || (!mrb_nil_p(dst) && (mrb_obj_ptr(dst) == mrb_obj_ptr(self)))) {
+    mrb_al_sample_block_t *block = mrb_al_pcm_new_storage(mrb, data, data->size);
+    mrb_al_pcm_interleave(block->bytes, data->buffer, &format, frames, interleave);
+    mrb_al_pcm_swap_storage(mrb, data, block, data->size);
+    return self;
+  }
+  mrb_al_sample_buffer_data_t *dst_data = mrb_al_pcm_prepare_dst(mrb, &dst, data->size);
+  mrb_al_pcm_interleave(dst_data->buffer, data->buffer, &format, frames, interleave);
+  dst_data->size = data->size;
+  return dst;
+}
+
+static mrb_value
+mrb_al_samplebuffer_interleave(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_reorder(mrb, self, true, false);
+}
+
+static mrb_value
+mrb_al_samplebuffer_interleave_bang(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_reorder(mrb, self, true, true);
+}
+
+static mrb_value
+mrb_al_samplebuffer_deinterleave(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_reorder(mrb, self, false, false);
+}
+
+static mrb_value
+mrb_al_samplebuffer_deinterleave_bang(mrb_state *mrb, mrb_value self)
+{
+  return mrb_al_samplebuffer_reorder(mrb, self, false, true);
+}
+
+/*
+ * DSP helpers. the sample type comes from an AL_FORMAT_* value; channels do
+ * not matter since every sample is treated alike. integer samples go through
+ * the float scratch block by block and saturate when encoded back.
+ */
+static size_t
+mrb_al_pcm_samples(mrb_state *mrb, mrb_al_sample_buffer_data_t const *data, mrb_int format_value, mrb_al_pcm_format_t *format)
+{
+  mrb_al_pcm_get_format(mrb, format_value, format);
+  return mrb_al_pcm_frames(mrb, data, format) * format->channels;
+}
+
+static mrb_value
+mrb_al_samplebuffer_apply_gain_bang(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_float gain;
+  mrb_get_args(mrb, "if", &format_value, &gain);
+  mrb_al_pcm_format_t format;
+  size_t const count = mrb_al_pcm_samples(mrb, data, format_value, &format);
+
+  if (MRB_AL_PCM_F32 == format.type) {
+    kernels->scale((float*)data->buffer, (float)gain, count);
+    return self;
+  }
+  float scratch[MRB_AL_PCM_BLOCK * 2];
+  size_t done;
+  for (done = 0; done < count; ) {
+    size_t const n = (count - done < MRB_AL_PCM_BLOCK * 2) ? count - done : MRB_AL_PCM_BLOCK * 2;
+    unsigned char *p = (unsigned char*)data->buffer + done * format.sample_size;
+    mrb_al_pcm_decode(scratch, p, format.type, n);
+    kernels->scale(scratch, (float)gain, n);
+    mrb_al_pcm_encode(p, scratch, format.type, n);
+    done += n;
+  }
+  return self;
+}
+
+/*
+ * adds the samples of the receiver, scaled by 'gain', onto 'other'.
+ * 'other' is extended with silence when it is shorter than the receiver.
+ */
+static mrb_value
+mrb_al_samplebuffer_mix_into_bang(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_value other;
+  mrb_float gain = 1.0;
+  mrb_get_args(mrb, "io|f", &format_value, &other, &gain);
+  mrb_al_sample_buffer_data_t *dst =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, other, &mrb_al_sample_buffer_data_type);
+  mrb_al_pcm_format_t format;
+  size_t const count = mrb_al_pcm_samples(mrb, data, format_value, &format);
+
+  if (dst->size < data->size) {
+    if (dst->capacity < data->size) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "insufficient capacity.");
+    }
+    memset((unsigned char*)dst->buffer + dst->size, (MRB_AL_PCM_U8 == format.type) ? 0x80 : 0, data->size - dst->size);
+    dst->size = data->size;
+  }
+  if (MRB_AL_PCM_F32 == format.type) {
+    kernels->mix((float*)dst->buffer, (float const*)data->buffer, (float)gain, count);
+    return other;
+  }
+  float src_scratch[MRB_AL_PCM_BLOCK * 2];
+  float dst_scratch[MRB_AL_PCM_BLOCK * 2];
+  size_t done;
+  for (done = 0; done < count; ) {
+    size_t const n = (count - done < MRB_AL_PCM_BLOCK * 2) ? count - done : MRB_AL_PCM_BLOCK * 2;
+    size_t const offset = done * format.sample_size;
+    mrb_al_pcm_decode(src_scratch, (unsigned char const*)data->buffer + offset, format.type, n);
+    mrb_al_pcm_decode(dst_scratch, (unsigned char const*)dst->buffer + offset, format.type, n);
+    kernels->mix(dst_scratch, src_scratch, (float)gain, n);
+    mrb_al_pcm_encode((unsigned char*)dst->buffer + offset, dst_scratch, format.type, n);
+    done += n;
+  }
+  return other;
+}
+
+/* limits float samples to [-1, 1]. integer samples are always in range. */
+static mrb_value
+mrb_al_samplebuffer_clip_bang(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_get_args(mrb, "i", &format_value);
+  mrb_al_pcm_format_t format;
+  size_t const count = mrb_al_pcm_samples(mrb, data, format_value, &format);
+  if (MRB_AL_PCM_F32 == format.type) {
+    kernels->clip((float*)data->buffer, count);
+  }
+  return self;
+}
+
+/* the largest absolute sample value, where full scale is 1.0. */
+static mrb_value
+mrb_al_samplebuffer_peak(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_get_args(mrb, "i", &format_value);
+  mrb_al_pcm_format_t format;
+  size_t const count = mrb_al_pcm_samples(mrb, data, format_value, &format);
+
+  if (MRB_AL_PCM_F32 == format.type) {
+    return mrb_float_value(mrb, kernels->peak((float const*)data->buffer, count));
+  }
+  float scratch[MRB_AL_PCM_BLOCK * 2];
+  float peak = 0.0f;
+  size_t done;
+  for (done = 0; done < count; ) {
+    size_t const n = (count - done < MRB_AL_PCM_BLOCK * 2) ? count - done : MRB_AL_PCM_BLOCK * 2;
+    mrb_al_pcm_decode(scratch, (unsigned char const*)data->buffer + done * format.sample_size, format.type, n);
+    float const v = kernels->peak(scratch, n);
+    peak = (v > peak) ? v : peak;
+    done += n;
+  }
+  return mrb_float_value(mrb, peak);
+}
+
+/* root mean square over all samples. partial sums are kept in double per block. */
+static mrb_value
+mrb_al_samplebuffer_rms(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  mrb_int format_value;
+  mrb_get_args(mrb, "i", &format_value);
+  mrb_al_pcm_format_t format;
+  size_t const count = mrb_al_pcm_samples(mrb, data, format_value, &format);
+  if (0 == count) {
+    return mrb_float_value(mrb, 0.0);
+  }
+
+  float scratch[MRB_AL_PCM_BLOCK * 2];
+  double sum = 0.0;
+  size_t done;
+  for (done = 0; done < count; ) {
+    size_t const n = (count - done < MRB_AL_PCM_BLOCK * 2) ? count - done : MRB_AL_PCM_BLOCK * 2;
+    float const *samples = (float const*)((unsigned char const*)data->buffer + done * format.sample_size);
+    if (MRB_AL_PCM_F32 != format.type) {
+      mrb_al_pcm_decode(scratch, samples, format.type, n);
+      samples = scratch;
+    }
+    sum += kernels->dot(samples, samples, n);
+    done += n;
+  }
+  return mrb_float_value(mrb, sqrt(sum / count));
+}
+
+static mrb_value
+mrb_al_samplebuffer_s_get_simd(mrb_state *mrb, mrb_value self)
+{
+  return mrb_symbol_value(mrb_intern(mrb, kernels->name, strlen(kernels->name)));
+}
+
+void
+mruby_openal_pcm_init(mrb_state *mrb)
+{
+#ifdef MRB_AL_PCM_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    kernels = &avx2_kernels;
+  } else if (__builtin_cpu_supports("sse2")) {
+    kernels = &sse2_kernels;
+  }
+#endif
+
+  mrb_define_class_method(mrb, class_SampleBuffer, "simd", mrb_al_samplebuffer_s_get_simd, ARGS_NONE());
+
+  mrb_define_method(mrb, class_SampleBuffer, "convert",       mrb_al_samplebuffer_convert,           ARGS_REQ(2) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "convert!",      mrb_al_samplebuffer_convert_bang,      ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "interleave",    mrb_al_samplebuffer_interleave,        ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "interleave!",   mrb_al_samplebuffer_interleave_bang,   ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "deinterleave",  mrb_al_samplebuffer_deinterleave,      ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "deinterleave!", mrb_al_samplebuffer_deinterleave_bang, ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "apply_gain!",   mrb_al_samplebuffer_apply_gain_bang,   ARGS_REQ(2));
+  mrb_define_method(mrb, class_SampleBuffer, "mix_into!",     mrb_al_samplebuffer_mix_into_bang,     ARGS_REQ(2) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_SampleBuffer, "clip!",         mrb_al_samplebuffer_clip_bang,         ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "peak",          mrb_al_samplebuffer_peak,              ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBuffer, "rms",           mrb_al_samplebuffer_rms,               ARGS_REQ(1));
+}
+
+void
+mruby_openal_pcm_final(mrb_state *mrb)
+{
+}
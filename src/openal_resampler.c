@@ -0,0 +1,492 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/hash.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* upper bound of the phase table. finer positions are interpolated between rows. */
+#define MRB_AL_RESAMPLER_MAX_PHASES 256
+#define MRB_AL_RESAMPLER_MAX_TAPS   1024
+/* frames produced per pass through the float scratch. */
+#define MRB_AL_RESAMPLER_BLOCK      256
+
+static struct RClass *class_Resampler = NULL;
+
+/*
+ * windowed-sinc polyphase resampler.
+ * the read position advances by from_hz / to_hz input frames per output frame
+ * and is tracked exactly as 'index' + 'fraction' / 'up'.
+ * input is kept planar in 'pending' so each tap sum is one contiguous dot product.
+ */
+typedef struct mrb_al_resampler_data_t {
+  mrb_al_pcm_format_t format;
+  mrb_int             from_hz;
+  mrb_int             to_hz;
+  mrb_int             up;
+  mrb_int             down;
+  size_t              taps;
+  size_t              phases;
+  float              *coefficients;
+  float              *pending;
+  size_t              pending_frames;
+  size_t              pending_capacity;
+  size_t              index;
+  mrb_int             fraction;
+  size_t              total_in;
+  size_t              total_out;
+} mrb_al_resampler_data_t;
+
+static void
+mrb_al_resampler_free(mrb_state *mrb, void *p)
+{
+  mrb_al_resampler_data_t *data = (mrb_al_resampler_data_t*)p;
+  if (NULL != data) {
+    mrb_free(mrb, data->coefficients);
+    mrb_free(mrb, data->pending);
+    mrb_free(mrb, data);
+  }
+}
+
+static struct mrb_data_type const mrb_al_resampler_data_type = { "Resampler", mrb_al_resampler_free };
+
+static double
+bessel_i0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  int k;
+  for (k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+static mrb_int
+gcd(mrb_int a, mrb_int b)
+{
+  while (0 != b) {
+    mrb_int const t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/* builds phases + 1 rows so that interpolation never reads past the table. */
+static void
+mrb_al_resampler_build_table(mrb_al_resampler_data_t *data, double cutoff, double beta)
+{
+  double const half = (double)(data->taps / 2);
+  double const norm = bessel_i0(beta);
+  size_t p, k;
+  for (p = 0; p <= data->phases; ++p) {
+    float *row = data->coefficients + p * data->taps;
+    double const t = (double)p / data->phases;
+    double sum = 0.0;
+    for (k = 0; k < data->taps; ++k) {
+      double const x = (double)k - half + 1.0 - t;
+      double const u = x / half;
+      double h = 2.0 * cutoff;
+      if (0.0 != x) {
+        h = sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+      }
+      h *= (1.0 < fabs(u)) ? 0.0 : bessel_i0(beta * sqrt(1.0 - u * u)) / norm;
+      row[k] = (float)h;
+      sum += h;
+    }
+    /* unity gain at DC for every phase. */
+    for (k = 0; k < data->taps; ++k) {
+      row[k] = (float)(row[k] / sum);
+    }
+  }
+}
+
+static void
+mrb_al_resampler_reset_state(mrb_al_resampler_data_t *data)
+{
+  size_t const history = data->taps / 2 - 1;
+  int c;
+  /* leading silence so the first output frame has its left context. */
+  for (c = 0; c < data->format.channels; ++c) {
+    memset(data->pending + c * data->pending_capacity, 0, history * sizeof(float));
+  }
+  data->pending_frames = history;
+  data->index = history;
+  data->fraction = 0;
+  data->total_in = 0;
+  data->total_out = 0;
+}
+
+static void
+mrb_al_resampler_reserve(mrb_state *mrb, mrb_al_resampler_data_t *data, size_t frames)
+{
+  if (frames <= data->pending_capacity) {
+    return;
+  }
+  size_t capacity = (0 < data->pending_capacity) ? data->pending_capacity : 1024;
+  while (capacity < frames) {
+    capacity *= 2;
+  }
+  float *pending = (float*)mrb_malloc(mrb, capacity * data->format.channels * sizeof(float));
+  if (NULL == pending) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  int c;
+  for (c = 0; c < data->format.channels; ++c) {
+    memcpy(pending + c * capacity, data->pending + c * data->pending_capacity, data->pending_frames * sizeof(float));
+  }
+  mrb_free(mrb, data->pending);
+  data->pending = pending;
+  data->pending_capacity = capacity;
+}
+
+/* appends 'frames' interleaved frames of 'src', deinterleaving into 'pending'. */
+static void
+mrb_al_resampler_feed(mrb_state *mrb, mrb_al_resampler_data_t *data, void const *src, size_t frames)
+{
+  mrb_al_resampler_reserve(mrb, data, data->pending_frames + frames);
+  int const channels = data->format.channels;
+  size_t const frame_size = data->format.sample_size * channels;
+  float block[MRB_AL_RESAMPLER_BLOCK * 2];
+  size_t done;
+  for (done = 0; done < frames; ) {
+    size_t const n = (frames - done < MRB_AL_RESAMPLER_BLOCK) ? frames - done : MRB_AL_RESAMPLER_BLOCK;
+    mrb_al_pcm_decode(block, (unsigned char const*)src + done * frame_size, data->format.type, n * channels);
+    int c;
+    size_t i;
+    for (c = 0; c < channels; ++c) {
+      float *dst = data->pending + c * data->pending_capacity + data->pending_frames;
+      for (i = 0; i < n; ++i) {
+        dst[i] = block[i * channels + c];
+      }
+    }
+    data->pending_frames += n;
+    done += n;
+  }
+}
+
+/* trailing silence so the last input frames get their right context. */
+static void
+mrb_al_resampler_pad_tail(mrb_state *mrb, mrb_al_resampler_data_t *data)
+{
+  size_t const half = data->taps / 2;
+  mrb_al_resampler_reserve(mrb, data, data->pending_frames + half);
+  int c;
+  for (c = 0; c < data->format.channels; ++c) {
+    memset(data->pending + c * data->pending_capacity + data->pending_frames, 0, half * sizeof(float));
+  }
+  data->pending_frames += half;
+}
+
+/*
+ * produces up to 'limit' frames into 'dst' while enough input is pending,
+ * then drops the consumed history. returns the number of frames written.
+ */
+static size_t
+mrb_al_resampler_drain(mrb_al_resampler_data_t *data, void *dst, size_t limit)
+{
+  int const channels = data->format.channels;
+  size_t const half = data->taps / 2;
+  size_t const frame_size = data->format.sample_size * channels;
+  float block[MRB_AL_RESAMPLER_BLOCK * 2];
+  size_t produced = 0;
+  while (produced < limit) {
+    size_t n = 0;
+    while ((n < MRB_AL_RESAMPLER_BLOCK) && (produced + n < limit) && (data->index + half < data->pending_frames)) {
+      /* position of the output frame within the phase table. */
+      mrb_int const scaled = data->fraction * (mrb_int)data->phases;
+      size_t const phase = (size_t)(scaled / data->up);
+      float const weight = (float)(scaled % data->up) / (float)data->up;
+      float const *row = data->coefficients + phase * data->taps;
+      size_t const first = data->index + 1 - half;
+      int c;
+      for (c = 0; c < channels; ++c) {
+        float const *in = data->pending + c * data->pending_capacity + first;
+        float v = mrb_al_pcm_dot(row, in, data->taps);
+        if (0.0f != weight) {
+          v += (mrb_al_pcm_dot(row + data->taps, in, data->taps) - v) * weight;
+        }
+        block[n * channels + c] = v;
+      }
+      data->fraction += data->down;
+      data->index += (size_t)(data->fraction / data->up);
+      data->fraction %= data->up;
+      ++n;
+    }
+    if (0 == n) {
+      break;
+    }
+    mrb_al_pcm_encode((unsigned char*)dst + produced * frame_size, block, data->format.type, n * channels);
+    produced += n;
+  }
+  data->total_out += produced;
+
+  size_t const keep_from = (data->index + 1 < half) ? 0 : data->index + 1 - half;
+  if (0 < keep_from) {
+    size_t const drop = (keep_from < data->pending_frames) ? keep_from : data->pending_frames;
+    int c;
+    for (c = 0; c < channels; ++c) {
+      float *p = data->pending + c * data->pending_capacity;
+      memmove(p, p + drop, (data->pending_frames - drop) * sizeof(float));
+    }
+    data->pending_frames -= drop;
+    data->index -= drop;
+  }
+  return produced;
+}
+
+/* output frames the pending input can still yield, rounded up. */
+static size_t
+mrb_al_resampler_estimate(mrb_al_resampler_data_t *data)
+{
+  size_t const half = data->taps / 2;
+  if (data->index + half >= data->pending_frames) {
+    return 0;
+  }
+  size_t const frames = data->pending_frames - half - data->index;
+  return (size_t)(((unsigned long long)frames * data->up + data->down - 1) / data->down) + 1;
+}
+
+static mrb_al_sample_buffer_data_t*
+mrb_al_resampler_prepare_dst(mrb_state *mrb, mrb_value *dst, size_t size)
+{
+  if (mrb_nil_p(*dst)) {
+    mrb_value arg = mrb_fixnum_value((0 < size) ? size : 1);
+    *dst = mrb_obj_new(mrb, class_SampleBuffer, 1, &arg);
+  }
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, *dst, &mrb_al_sample_buffer_data_type);
+  return data;
+}
+
+static size_t
+mrb_al_resampler_get_taps(mrb_state *mrb, mrb_value quality, double *rolloff, double *beta)
+{
+  if (mrb_hash_p(quality)) {
+    quality = mrb_hash_get(mrb, quality, mrb_symbol_value(mrb_intern(mrb, "quality", 7)));
+  }
+  if (mrb_nil_p(quality)) {
+    quality = mrb_symbol_value(mrb_intern(mrb, "medium", 6));
+  }
+  if (!mrb_symbol_p(quality)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "quality must be symbol type.");
+  }
+  mrb_sym const sym = mrb_symbol(quality);
+  if (sym == mrb_intern(mrb, "low", 3)) {
+    *rolloff = 0.80; *beta = 5.0;
+    return 8;
+  } else if (sym == mrb_intern(mrb, "medium", 6)) {
+    *rolloff = 0.90; *beta = 6.5;
+    return 16;
+  } else if (sym == mrb_intern(mrb, "high", 4)) {
+    *rolloff = 0.94; *beta = 8.6;
+    return 32;
+  } else if (sym == mrb_intern(mrb, "best", 4)) {
+    *rolloff = 0.96; *beta = 10.0;
+    return 64;
+  }
+  mrb_raise(mrb, E_ARGUMENT_ERROR, "quality must be one of :low, :medium, :high or :best.");
+  return 0;
+}
+
+static mrb_value
+mrb_al_resampler_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)DATA_PTR(self);
+  mrb_int format_value, from_hz, to_hz;
+  mrb_value quality = mrb_nil_value();
+  mrb_get_args(mrb, "iii|o", &format_value, &from_hz, &to_hz, &quality);
+
+  mrb_al_pcm_format_t format;
+  mrb_al_pcm_get_format(mrb, format_value, &format);
+  if ((from_hz <= 0) || (to_hz <= 0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "frequency must be positive.");
+  }
+  double rolloff, beta;
+  size_t taps = mrb_al_resampler_get_taps(mrb, quality, &rolloff, &beta);
+  mrb_int const g = gcd(from_hz, to_hz);
+  mrb_int const up = to_hz / g;
+  mrb_int const down = from_hz / g;
+  /* widen the kernel when decimating so the transition band keeps its width. */
+  if (down > up) {
+    taps *= (size_t)((down + up - 1) / up);
+    if (taps > MRB_AL_RESAMPLER_MAX_TAPS) {
+      taps = MRB_AL_RESAMPLER_MAX_TAPS;
+    }
+  }
+
+  if (NULL != data) {
+    mrb_al_resampler_free(mrb, data);
+  }
+  data = (mrb_al_resampler_data_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_resampler_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_resampler_data_type;
+
+  data->format = format;
+  data->from_hz = from_hz;
+  data->to_hz = to_hz;
+  data->up = up;
+  data->down = down;
+  data->taps = taps;
+  data->phases = (up < MRB_AL_RESAMPLER_MAX_PHASES) ? (size_t)up : MRB_AL_RESAMPLER_MAX_PHASES;
+  data->coefficients = (float*)mrb_malloc(mrb, (data->phases + 1) * taps * sizeof(float));
+  if (NULL == data->coefficients) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  double const ratio = (down > up) ? (double)up / down : 1.0;
+  mrb_al_resampler_build_table(data, 0.5 * ratio * rolloff, beta);
+  mrb_al_resampler_reserve(mrb, data, taps);
+  mrb_al_resampler_reset_state(data);
+
+  return self;
+}
+
+static size_t
+mrb_al_resampler_frames(mrb_state *mrb, mrb_al_resampler_data_t *data, mrb_al_sample_buffer_data_t *src)
+{
+  size_t const frame_size = data->format.sample_size * data->format.channels;
+  if (0 != (src->size % frame_size)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "buffer size is not a multiple of the frame size.");
+  }
+  return src->size / frame_size;
+}
+
+/*
+ * resamples one chunk. state carries over to the next call, so a stream
+ * can be fed in arbitrary pieces. returns 'dst' (or a new SampleBuffer)
+ * holding as many frames as the input seen so far allows.
+ */
+static mrb_value
+mrb_al_resampler_process(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  mrb_value src, dst = mrb_nil_value();
+  mrb_get_args(mrb, "o|o", &src, &dst);
+  mrb_al_sample_buffer_data_t *src_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, src, &mrb_al_sample_buffer_data_type);
+  size_t const frames = mrb_al_resampler_frames(mrb, data, src_data);
+  size_t const frame_size = data->format.sample_size * data->format.channels;
+
+  mrb_al_resampler_feed(mrb, data, src_data->buffer, frames);
+  data->total_in += frames;
+  size_t const estimate = mrb_al_resampler_estimate(data);
+  mrb_al_sample_buffer_data_t *dst_data = mrb_al_resampler_prepare_dst(mrb, &dst, estimate * frame_size);
+  size_t const produced = mrb_al_resampler_drain(data, dst_data->buffer, dst_data->capacity / frame_size);
+  dst_data->size = produced * frame_size;
+  return dst;
+}
+
+/* pushes the tail through the filter. the stream can be reused afterwards. */
+static mrb_value
+mrb_al_resampler_flush(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  mrb_value dst = mrb_nil_value();
+  mrb_get_args(mrb, "|o", &dst);
+  size_t const frame_size = data->format.sample_size * data->format.channels;
+
+  mrb_al_resampler_pad_tail(mrb, data);
+  size_t const expected = (size_t)(((unsigned long long)data->total_in * data->up + data->down - 1) / data->down);
+  size_t const remaining = (expected > data->total_out) ? expected - data->total_out : 0;
+  mrb_al_sample_buffer_data_t *dst_data = mrb_al_resampler_prepare_dst(mrb, &dst, remaining * frame_size);
+  size_t const limit = dst_data->capacity / frame_size;
+  if (limit < remaining) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "insufficient capacity.");
+  }
+  dst_data->size = mrb_al_resampler_drain(data, dst_data->buffer, remaining) * frame_size;
+  mrb_al_resampler_reset_state(data);
+  return dst;
+}
+
+static mrb_value
+mrb_al_resampler_reset(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  mrb_al_resampler_reset_state(data);
+  return self;
+}
+
+static mrb_value
+mrb_al_resampler_get_from_hz(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  return mrb_fixnum_value(data->from_hz);
+}
+
+static mrb_value
+mrb_al_resampler_get_to_hz(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  return mrb_fixnum_value(data->to_hz);
+}
+
+static mrb_value
+mrb_al_resampler_get_taps_count(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_resampler_data_type);
+  return mrb_fixnum_value(data->taps);
+}
+
+/* one-shot resampling of a whole buffer: resample(format, from_hz, to_hz[, quality: :medium]) */
+static mrb_value
+mrb_al_samplebuffer_resample(mrb_state *mrb, mrb_value self)
+{
+  mrb_value argv[4];
+  mrb_value quality = mrb_nil_value();
+  int const argc = mrb_get_args(mrb, "ooo|o", &argv[0], &argv[1], &argv[2], &quality);
+  argv[3] = quality;
+  mrb_value resampler = mrb_obj_new(mrb, class_Resampler, argc, argv);
+  mrb_al_resampler_data_t *data =
+    (mrb_al_resampler_data_t*)mrb_data_get_ptr(mrb, resampler, &mrb_al_resampler_data_type);
+  mrb_al_sample_buffer_data_t *src_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_buffer_data_type);
+  size_t const frames = mrb_al_resampler_frames(mrb, data, src_data);
+  size_t const frame_size = data->format.sample_size * data->format.channels;
+  size_t const expected = (size_t)(((unsigned long long)frames * data->up + data->down - 1) / data->down);
+
+  mrb_value dst = mrb_nil_value();
+  mrb_al_sample_buffer_data_t *dst_data = mrb_al_resampler_prepare_dst(mrb, &dst, expected * frame_size);
+  mrb_al_resampler_feed(mrb, data, src_data->buffer, frames);
+  data->total_in = frames;
+  mrb_al_resampler_pad_tail(mrb, data);
+  dst_data->size = mrb_al_resampler_drain(data, dst_data->buffer, expected) * frame_size;
+  return dst;
+}
+
+void
+mruby_openal_resampler_init(mrb_state *mrb)
+{
+  class_Resampler = mrb_define_class_under(mrb, mod_AL, "Resampler", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_Resampler, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_Resampler, "initialize", mrb_al_resampler_initialize,     ARGS_REQ(3) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_Resampler, "process",    mrb_al_resampler_process,        ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_Resampler, "flush",      mrb_al_resampler_flush,          ARGS_OPT(1));
+  mrb_define_method(mrb, class_Resampler, "reset",      mrb_al_resampler_reset,          ARGS_NONE());
+  mrb_define_method(mrb, class_Resampler, "from_hz",    mrb_al_resampler_get_from_hz,    ARGS_NONE());
+  mrb_define_method(mrb, class_Resampler, "to_hz",      mrb_al_resampler_get_to_hz,      ARGS_NONE());
+  mrb_define_method(mrb, class_Resampler, "taps",       mrb_al_resampler_get_taps_count, ARGS_NONE());
+
+  mrb_define_method(mrb, class_SampleBuffer, "resample", mrb_al_samplebuffer_resample, ARGS_REQ(3) | ARGS_OPT(1));
+}
+
+void
+mruby_openal_resampler_final(mrb_state *mrb)
+{
+}
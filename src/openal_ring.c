@@ -0,0 +1,238 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/string.h"
+#include <string.h>
+
+#define RING_LOAD_ACQUIRE(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_LOAD_RELAXED(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+#define RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static struct RClass *class_RingBuffer = NULL;
+
+void
+mrb_al_ring_init(mrb_state *mrb, mrb_al_ring_t *ring, size_t capacity)
+{
+  size_t size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  ring->buffer = NULL;
+  ring->capacity = 0;
+  ring->mask = 0;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->buffer = (unsigned char*)mrb_malloc(mrb, size);
+  if (NULL == ring->buffer) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  ring->capacity = size;
+  ring->mask = size - 1;
+}
+
+void
+mrb_al_ring_destroy(mrb_state *mrb, mrb_al_ring_t *ring)
+{
+  mrb_free(mrb, ring->buffer);
+  ring->buffer = NULL;
+  ring->capacity = 0;
+  ring->mask = 0;
+  ring->head = 0;
+  ring->tail = 0;
+}
+
+void
+mrb_al_ring_retain(mrb_al_ring_t *ring)
+{
+  ++ring->refs;
+}
+
+/* drops one owner of a RingBuffer ring. the storage goes with the last one. */
+void
+mrb_al_ring_release(mrb_state *mrb, mrb_al_ring_t *ring)
+{
+  if ((NULL != ring) && (0 == --ring->refs)) {
+    mrb_al_ring_destroy(mrb, ring);
+    mrb_free(mrb, ring);
+  }
+}
+
+size_t
+mrb_al_ring_available(mrb_al_ring_t *ring)
+{
+  return RING_LOAD_ACQUIRE(&ring->head) - RING_LOAD_ACQUIRE(&ring->tail);
+}
+
+size_t
+mrb_al_ring_free_space(mrb_al_ring_t *ring)
+{
+  return ring->capacity - mrb_al_ring_available(ring);
+}
+
+/* producer side. returns the number of bytes actually stored. */
+size_t
+mrb_al_ring_write(mrb_al_ring_t *ring, void const *src, size_t size)
+{
+  size_t const head = RING_LOAD_RELAXED(&ring->head);
+  size_t const tail = RING_LOAD_ACQUIRE(&ring->tail);
+  size_t const space = ring->capacity - (head - tail);
+  if (size > space) {
+    size = space;
+  }
+  if (0 == size) {
+    return 0;
+  }
+  size_t const offset = head & ring->mask;
+  size_t const first = (size < ring->capacity - offset) ? size : ring->capacity - offset;
+  memcpy(ring->buffer + offset, src, first);
+  memcpy(ring->buffer, (unsigned char const*)src + first, size - first);
+  RING_STORE_RELEASE(&ring->head, head + size);
+  return size;
+}
+
+/* consumer side. returns the number of bytes actually fetched. */
+size_t
+mrb_al_ring_read(mrb_al_ring_t *ring, void *dst, size_t size)
+{
+  size_t const tail = RING_LOAD_RELAXED(&ring->tail);
+  size_t const head = RING_LOAD_ACQUIRE(&ring->head);
+  size_t const used = head - tail;
+  if (size > used) {
+    size = used;
+  }
+  if (0 == size) {
+    return 0;
+  }
+  size_t const offset = tail & ring->mask;
+  size_t const first = (size < ring->capacity - offset) ? size : ring->capacity - offset;
+  memcpy(dst, ring->buffer + offset, first);
+  memcpy((unsigned char*)dst + first, ring->buffer, size - first);
+  RING_STORE_RELEASE(&ring->tail, tail + size);
+  return size;
+}
+
+static void
+mrb_al_ring_free(mrb_state *mrb, void *p)
+{
+  mrb_al_ring_release(mrb, (mrb_al_ring_t*)p);
+}
+
+struct mrb_data_type const mrb_al_ring_data_type = { "RingBuffer", mrb_al_ring_free };
+
+static mrb_value
+mrb_al_ringbuffer_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)DATA_PTR(self);
+  mrb_int capacity;
+  mrb_get_args(mrb, "i", &capacity);
+
+  if (capacity <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "capacity must be positive.");
+  }
+  if (NULL != data) {
+    /* a native worker such as a capture pump is still writing into it. */
+    if (1 < data->refs) {
+      mrb_raise(mrb, E_RUNTIME_ERROR, "ring buffer is in use and cannot be reinitialized.");
+    }
+    mrb_al_ring_free(mrb, data);
+  }
+  data = (mrb_al_ring_t*)mrb_malloc(mrb, sizeof(mrb_al_ring_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->buffer = NULL;
+  data->capacity = 0;
+  data->refs = 1;
+
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_ring_data_type;
+
+  mrb_al_ring_init(mrb, data, (size_t)capacity);
+
+  return self;
+}
+
+static mrb_value
+mrb_al_ringbuffer_write(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, self, &mrb_al_ring_data_type);
+  mrb_value samples;
+  mrb_get_args(mrb, "o", &samples);
+  /* an attached worker is the producer; a second one would race on 'head'. */
+  if (1 < data->refs) {
+    mrb_raise(mrb, class_ALError, "ring buffer is fed by a native worker and cannot be written.");
+  }
+  if (mrb_string_p(samples)) {
+    return mrb_fixnum_value(mrb_al_ring_write(data, RSTRING_PTR(samples), RSTRING_LEN(samples)));
+  }
+  mrb_al_sample_buffer_data_t *samples_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, samples, &mrb_al_sample_buffer_data_type);
+  return mrb_fixnum_value(mrb_al_ring_write(data, samples_data->buffer, samples_data->size));
+}
+
+static mrb_value
+mrb_al_ringbuffer_read_into(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, self, &mrb_al_ring_data_type);
+  mrb_value samples;
+  mrb_int size;
+  int const argc = mrb_get_args(mrb, "o|i", &samples, &size);
+  mrb_al_sample_buffer_data_t *samples_data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, samples, &mrb_al_sample_buffer_data_type);
+  size_t request = samples_data->capacity;
+  if (1 < argc) {
+    if ((size < 0) || ((size_t)size > samples_data->capacity)) {
+      mrb_raise(mrb, E_ARGUMENT_ERROR, "too many bytes are requested.");
+    }
+    request = (size_t)size;
+  }
+  samples_data->size = mrb_al_ring_read(data, samples_data->buffer, request);
+  return mrb_fixnum_value(samples_data->size);
+}
+
+static mrb_value
+mrb_al_ringbuffer_get_capacity(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, self, &mrb_al_ring_data_type);
+  return mrb_fixnum_value(data->capacity);
+}
+
+static mrb_value
+mrb_al_ringbuffer_get_available(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, self, &mrb_al_ring_data_type);
+  return mrb_fixnum_value(mrb_al_ring_available(data));
+}
+
+static mrb_value
+mrb_al_ringbuffer_get_free_space(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_ring_t *data =
+    (mrb_al_ring_t*)mrb_data_get_ptr(mrb, self, &mrb_al_ring_data_type);
+  return mrb_fixnum_value(mrb_al_ring_free_space(data));
+}
+
+void
+mruby_openal_ring_init(mrb_state *mrb)
+{
+  class_RingBuffer = mrb_define_class_under(mrb, mod_AL, "RingBuffer", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_RingBuffer, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_RingBuffer, "initialize", mrb_al_ringbuffer_initialize,     ARGS_REQ(1));
+  mrb_define_method(mrb, class_RingBuffer, "write",      mrb_al_ringbuffer_write,          ARGS_REQ(1));
+  mrb_define_method(mrb, class_RingBuffer, "<<",         mrb_al_ringbuffer_write,          ARGS_REQ(1));
+  mrb_define_method(mrb, class_RingBuffer, "read_into",  mrb_al_ringbuffer_read_into,      ARGS_REQ(1) | ARGS_OPT(1));
+  mrb_define_method(mrb, class_RingBuffer, "capacity",   mrb_al_ringbuffer_get_capacity,   ARGS_NONE());
+  mrb_define_method(mrb, class_RingBuffer, "available",  mrb_al_ringbuffer_get_available,  ARGS_NONE());
+  mrb_define_method(mrb, class_RingBuffer, "free_space", mrb_al_ringbuffer_get_free_space, ARGS_NONE());
+}
+
+void
+mruby_openal_ring_final(mrb_state *mrb)
+{
+}
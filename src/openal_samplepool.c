@@ -0,0 +1,261 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MRB_AL_SAMPLE_POOL_ALIGNMENT 64
+
+/* room before the payload for the SampleBuffer header and the block header. */
+#define MRB_AL_SAMPLE_POOL_PREFIX \
+  ((sizeof(mrb_al_sample_buffer_data_t) + offsetof(mrb_al_sample_block_t, bytes) + MRB_AL_SAMPLE_POOL_ALIGNMENT - 1) & \
+   ~(size_t)(MRB_AL_SAMPLE_POOL_ALIGNMENT - 1))
+
+static struct RClass *class_SampleBufferPool = NULL;
+
+/*
+ * fixed-size blocks carved from slabs. each slot is laid out so that the
+ * payload ('bytes' of the block header) starts on a 64-byte boundary, with
+ * the header of the SampleBuffer handed out right before the block header.
+ * 'refs' counts the Ruby object plus every block handed out, so the slabs
+ * survive the pool object until the last buffer is gone.
+ */
+typedef struct mrb_al_sample_pool_t {
+  size_t                  refs;
+  size_t                  block_size;
+  size_t                  stride;
+  mrb_int                 blocks_per_slab;
+  mrb_int                 max_slabs;
+  mrb_int                 slab_count;
+  void                  **slabs;
+  mrb_al_sample_block_t **free_blocks;
+  mrb_int                 free_count;
+} mrb_al_sample_pool_t;
+
+static void
+mrb_al_sample_pool_destroy(mrb_state *mrb, mrb_al_sample_pool_t *pool)
+{
+  mrb_int i;
+  for (i = 0; i < pool->slab_count; ++i) {
+    mrb_free(mrb, pool->slabs[i]);
+  }
+  mrb_free(mrb, pool->slabs);
+  mrb_free(mrb, pool->free_blocks);
+  mrb_free(mrb, pool);
+}
+
+static void
+mrb_al_sample_pool_unref(mrb_state *mrb, mrb_al_sample_pool_t *pool)
+{
+  if (0 == --pool->refs) {
+    mrb_al_sample_pool_destroy(mrb, pool);
+  }
+}
+
+void
+mrb_al_sample_pool_put(mrb_state *mrb, struct mrb_al_sample_pool_t *pool, mrb_al_sample_block_t *block)
+{
+  pool->free_blocks[pool->free_count++] = block;
+  mrb_al_sample_pool_unref(mrb, pool);
+}
+
+/* adds one slab. returns false when the pool may not grow any more. */
+static bool
+mrb_al_sample_pool_grow(mrb_state *mrb, mrb_al_sample_pool_t *pool)
+{
+  if ((0 < pool->max_slabs) && (pool->slab_count >= pool->max_slabs)) {
+    return false;
+  }
+  mrb_int const total = (pool->slab_count + 1) * pool->blocks_per_slab;
+  void **slabs = (void**)mrb_realloc(mrb, pool->slabs, sizeof(void*) * (pool->slab_count + 1));
+  if (NULL == slabs) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  pool->slabs = slabs;
+  mrb_al_sample_block_t **free_blocks =
+    (mrb_al_sample_block_t**)mrb_realloc(mrb, pool->free_blocks, sizeof(mrb_al_sample_block_t*) * total);
+  if (NULL == free_blocks) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  pool->free_blocks = free_blocks;
+  unsigned char *slab = (unsigned char*)mrb_malloc(mrb, pool->stride * pool->blocks_per_slab + MRB_AL_SAMPLE_POOL_ALIGNMENT);
+  if (NULL == slab) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  pool->slabs[pool->slab_count++] = slab;
+
+  uintptr_t const aligned =
+    ((uintptr_t)slab + MRB_AL_SAMPLE_POOL_ALIGNMENT - 1) & ~(uintptr_t)(MRB_AL_SAMPLE_POOL_ALIGNMENT - 1);
+  mrb_int i;
+  for (i = 0; i < pool->blocks_per_slab; ++i) {
+    unsigned char *payload = (unsigned char*)aligned + pool->stride * i + MRB_AL_SAMPLE_POOL_PREFIX;
+    mrb_al_sample_block_t *block = (mrb_al_sample_block_t*)(payload - offsetof(mrb_al_sample_block_t, bytes));
+    block->refs = 0;
+    block->capacity = pool->block_size;
+    block->pool = pool;
+    block->external = NULL;
+    pool->free_blocks[pool->free_count++] = block;
+  }
+  return true;
+}
+
+static void
+mrb_al_samplebufferpool_free(mrb_state *mrb, void *p)
+{
+  mrb_al_sample_pool_t *pool = (mrb_al_sample_pool_t*)p;
+  if (NULL != pool) {
+    mrb_al_sample_pool_unref(mrb, pool);
+  }
+}
+
+static struct mrb_data_type const mrb_al_sample_pool_data_type = { "SampleBufferPool", mrb_al_samplebufferpool_free };
+
+static mrb_value
+mrb_al_samplebufferpool_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)DATA_PTR(self);
+  mrb_int block_size;
+  mrb_int blocks_per_slab = 64;
+  mrb_int max_slabs = 0;
+  mrb_get_args(mrb, "i|ii", &block_size, &blocks_per_slab, &max_slabs);
+
+  if ((block_size <= 0) || (blocks_per_slab <= 0) || (max_slabs < 0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "invalid pool parameter is supplied.");
+  }
+  if (NULL != pool) {
+    mrb_al_samplebufferpool_free(mrb, pool);
+  }
+  pool = (mrb_al_sample_pool_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_sample_pool_t));
+  if (NULL == pool) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  pool->refs = 1;
+  pool->block_size = (size_t)block_size;
+  pool->stride = MRB_AL_SAMPLE_POOL_PREFIX +
+    (((size_t)block_size + MRB_AL_SAMPLE_POOL_ALIGNMENT - 1) & ~(size_t)(MRB_AL_SAMPLE_POOL_ALIGNMENT - 1));
+  pool->blocks_per_slab = blocks_per_slab;
+  pool->max_slabs = max_slabs;
+
+  DATA_PTR(self) = pool;
+  DATA_TYPE(self) = &mrb_al_sample_pool_data_type;
+
+  mrb_al_sample_pool_grow(mrb, pool);
+
+  return self;
+}
+
+/* returns an empty SampleBuffer of 'block_size' capacity, or nil once 'max_slabs' is exhausted. */
+static mrb_value
+mrb_al_samplebufferpool_acquire(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  if ((0 == pool->free_count) && !mrb_al_sample_pool_grow(mrb, pool)) {
+    return mrb_nil_value();
+  }
+  mrb_al_sample_block_t *block = pool->free_blocks[--pool->free_count];
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)((unsigned char*)block - sizeof(mrb_al_sample_buffer_data_t));
+  /* one reference for the storage and one for the header in the slot. */
+  block->refs = 2;
+  ++pool->refs;
+  data->buffer = block->bytes;
+  data->capacity = block->capacity;
+  data->size = 0;
+  data->block = block;
+  data->slot = block;
+  return mrb_obj_value(Data_Wrap_Struct(mrb, class_SampleBuffer, &mrb_al_sample_buffer_data_type, data));
+}
+
+/*
+ * gives the storage of 'buffer' back without waiting for GC.
+ * the buffer is left empty with no capacity; views of it keep the block
+ * until they are collected. a header carved from the slot moves to the heap
+ * so that the slot can go back as well.
+ */
+static mrb_value
+mrb_al_samplebufferpool_release(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  mrb_value buffer;
+  mrb_get_args(mrb, "o", &buffer);
+  mrb_al_sample_buffer_data_t *data =
+    (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, buffer, &mrb_al_sample_buffer_data_type);
+  if ((NULL == data->block) || (pool != data->block->pool)) {
+    return mrb_false_value();
+  }
+  mrb_al_sample_block_release(mrb, data->block);
+  data->block = NULL;
+  data->buffer = NULL;
+  data->capacity = 0;
+  data->size = 0;
+  mrb_al_sample_block_t *slot = data->slot;
+  if (NULL != slot) {
+    mrb_al_sample_buffer_data_t *moved =
+      (mrb_al_sample_buffer_data_t*)mrb_malloc(mrb, sizeof(mrb_al_sample_buffer_data_t));
+    if (NULL == moved) {
+      mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+    }
+    *moved = *data;
+    moved->slot = NULL;
+    DATA_PTR(buffer) = moved;
+    mrb_al_sample_block_release(mrb, slot);
+  }
+  return mrb_true_value();
+}
+
+static mrb_value
+mrb_al_samplebufferpool_get_block_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  return mrb_fixnum_value(pool->block_size);
+}
+
+static mrb_value
+mrb_al_samplebufferpool_get_available(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  return mrb_fixnum_value(pool->free_count);
+}
+
+static mrb_value
+mrb_al_samplebufferpool_get_allocated(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  return mrb_fixnum_value(pool->slab_count * pool->blocks_per_slab);
+}
+
+static mrb_value
+mrb_al_samplebufferpool_get_slabs(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_sample_pool_t *pool =
+    (mrb_al_sample_pool_t*)mrb_data_get_ptr(mrb, self, &mrb_al_sample_pool_data_type);
+  return mrb_fixnum_value(pool->slab_count);
+}
+
+void
+mruby_openal_samplepool_init(mrb_state *mrb)
+{
+  class_SampleBufferPool = mrb_define_class_under(mrb, mod_AL, "SampleBufferPool", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_SampleBufferPool, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_SampleBufferPool, "initialize", mrb_al_samplebufferpool_initialize,     ARGS_REQ(1) | ARGS_OPT(2));
+  mrb_define_method(mrb, class_SampleBufferPool, "acquire",    mrb_al_samplebufferpool_acquire,        ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBufferPool, "release",    mrb_al_samplebufferpool_release,        ARGS_REQ(1));
+  mrb_define_method(mrb, class_SampleBufferPool, "block_size", mrb_al_samplebufferpool_get_block_size, ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBufferPool, "available",  mrb_al_samplebufferpool_get_available,  ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBufferPool, "allocated",  mrb_al_samplebufferpool_get_allocated,  ARGS_NONE());
+  mrb_define_method(mrb, class_SampleBufferPool, "slabs",      mrb_al_samplebufferpool_get_slabs,      ARGS_NONE());
+}
+
+void
+mruby_openal_samplepool_final(mrb_state *mrb)
+{
+}
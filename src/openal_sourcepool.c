@@ -0,0 +1,252 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/hash.h"
+#include "mruby/variable.h"
+#include <AL/al.h>
+#include <stdbool.h>
+
+static struct RClass *class_SourcePool = NULL;
+
+typedef struct mrb_al_source_pool_data_t {
+  ALsizei  size;
+  ALuint  *sources;
+  bool    *in_use;
+  mrb_int *priorities;
+} mrb_al_source_pool_data_t;
+
+static void
+mrb_al_source_pool_free(mrb_state *mrb, void *p)
+{
+  mrb_al_source_pool_data_t *data = (mrb_al_source_pool_data_t*)p;
+  if (NULL != data) {
+    mrb_free(mrb, data->in_use);
+    mrb_free(mrb, data->priorities);
+    mrb_free(mrb, data);
+  }
+}
+
+static struct mrb_data_type const mrb_al_source_pool_data_type = { "SourcePool", mrb_al_source_pool_free };
+
+static mrb_value
+mrb_al_sourcepool_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)DATA_PTR(self);
+  mrb_int size;
+  mrb_get_args(mrb, "i", &size);
+
+  if (size <= 0) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "pool size must be positive.");
+  }
+  mrb_value arg = mrb_fixnum_value(size);
+  mrb_value sources = mrb_obj_new(mrb, class_Sources, 1, &arg);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@sources", 8), sources);
+  mrb_al_sources_data_t *sources_data =
+    (mrb_al_sources_data_t*)mrb_data_get_ptr(mrb, sources, &mrb_al_sources_data_type);
+
+  if (NULL != data) {
+    mrb_al_source_pool_free(mrb, data);
+  }
+  data = (mrb_al_source_pool_data_t*)mrb_malloc(mrb, sizeof(mrb_al_source_pool_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->size = sources_data->size;
+  data->sources = sources_data->sources;
+  data->in_use = NULL;
+  data->priorities = NULL;
+
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_source_pool_data_type;
+
+  data->in_use = (bool*)mrb_calloc(mrb, data->size, sizeof(bool));
+  data->priorities = (mrb_int*)mrb_calloc(mrb, data->size, sizeof(mrb_int));
+  if ((NULL == data->in_use) || (NULL == data->priorities)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+
+  return self;
+}
+
+/* hands stopped voices back to the pool. */
+static void
+mrb_al_sourcepool_reclaim(mrb_al_source_pool_data_t *data)
+{
+  ALsizei i;
+  for (i = 0; i < data->size; ++i) {
+    if (data->in_use[i]) {
+      ALint state = AL_INITIAL;
+      alGetSourcei(data->sources[i], AL_SOURCE_STATE, &state);
+      if (AL_STOPPED == state) {
+        data->in_use[i] = false;
+      }
+    }
+  }
+}
+
+/*
+ * picks the lowest priority voice not above 'priority'.
+ * ties are broken by the lowest gain.
+ */
+static ALsizei
+mrb_al_sourcepool_find_victim(mrb_al_source_pool_data_t *data, mrb_int priority)
+{
+  ALsizei victim = -1;
+  ALfloat victim_gain = 0.0f;
+  ALsizei i;
+  for (i = 0; i < data->size; ++i) {
+    if (data->priorities[i] > priority) {
+      continue;
+    }
+    ALfloat gain = 1.0f;
+    alGetSourcef(data->sources[i], AL_GAIN, &gain);
+    if ((victim < 0) ||
+        (data->priorities[i] < data->priorities[victim]) ||
+        ((data->priorities[i] == data->priorities[victim]) && (gain < victim_gain))) {
+      victim = i;
+      victim_gain = gain;
+    }
+  }
+  return victim;
+}
+
+static mrb_value
+mrb_al_sourcepool_reset(mrb_state *mrb, mrb_value self, mrb_al_source_pool_data_t *data, ALsizei index)
+{
+  ALuint const source = data->sources[index];
+  /* rewinding leaves the voice in AL_INITIAL so it is not reclaimed before it is played. */
+  alSourceStop(source);
+  alSourceRewind(source);
+  alSourcei(source, AL_BUFFER, AL_NONE);
+  alSourcei(source, AL_LOOPING, AL_FALSE);
+  alSourcei(source, AL_SOURCE_RELATIVE, AL_FALSE);
+  alSourcef(source, AL_GAIN, 1.0f);
+  alSourcef(source, AL_PITCH, 1.0f);
+  alSource3f(source, AL_POSITION, 0.0f, 0.0f, 0.0f);
+  alSource3f(source, AL_VELOCITY, 0.0f, 0.0f, 0.0f);
+  mrb_value const wrapper =
+    mrb_al_sources_at(mrb, mrb_iv_get(mrb, self, mrb_intern(mrb, "@sources", 8)), index);
+  mrb_iv_set(mrb, wrapper, mrb_intern(mrb, "@buffer", 7), mrb_nil_value());
+  return wrapper;
+}
+
+static mrb_value
+mrb_al_sourcepool_acquire(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_pool_data_type);
+  mrb_value arg = mrb_fixnum_value(0);
+  mrb_get_args(mrb, "|o", &arg);
+  if (mrb_hash_p(arg)) {
+    arg = mrb_hash_get(mrb, arg, mrb_symbol_value(mrb_intern(mrb, "priority", 8)));
+    if (mrb_nil_p(arg)) {
+      arg = mrb_fixnum_value(0);
+    }
+  }
+  if (!mrb_fixnum_p(arg)) {
+    mrb_raise(mrb, E_TYPE_ERROR, "priority must be integer type.");
+  }
+  mrb_int const priority = mrb_fixnum(arg);
+
+  mrb_al_sourcepool_reclaim(data);
+  ALsizei index = -1;
+  ALsizei i;
+  for (i = 0; i < data->size; ++i) {
+    if (!data->in_use[i]) {
+      index = i;
+      break;
+    }
+  }
+  if (index < 0) {
+    index = mrb_al_sourcepool_find_victim(data, priority);
+    if (index < 0) {
+      return mrb_nil_value();
+    }
+  }
+  mrb_value const source = mrb_al_sourcepool_reset(mrb, self, data, index);
+  mrb_al_check_error(mrb);
+  data->in_use[index] = true;
+  data->priorities[index] = priority;
+  return source;
+}
+
+static mrb_value
+mrb_al_sourcepool_release(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_pool_data_type);
+  mrb_value source;
+  mrb_get_args(mrb, "o", &source);
+  mrb_value const sources = mrb_iv_get(mrb, self, mrb_intern(mrb, "@sources", 8));
+  ALsizei i;
+  for (i = 0; i < data->size; ++i) {
+    if (mrb_obj_ptr(mrb_al_sources_at(mrb, sources, i)) == mrb_obj_ptr(source)) {
+      if (data->in_use[i]) {
+        alSourceStop(data->sources[i]);
+        data->in_use[i] = false;
+      }
+      return mrb_true_value();
+    }
+  }
+  return mrb_false_value();
+}
+
+static mrb_value
+mrb_al_sourcepool_recycle(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_pool_data_type);
+  mrb_al_sourcepool_reclaim(data);
+  return self;
+}
+
+static mrb_value
+mrb_al_sourcepool_get_size(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_pool_data_type);
+  return mrb_fixnum_value(data->size);
+}
+
+static mrb_value
+mrb_al_sourcepool_get_available(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_source_pool_data_t *data =
+    (mrb_al_source_pool_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_source_pool_data_type);
+  mrb_al_sourcepool_reclaim(data);
+  mrb_int count = 0;
+  ALsizei i;
+  for (i = 0; i < data->size; ++i) {
+    if (!data->in_use[i]) {
+      ++count;
+    }
+  }
+  return mrb_fixnum_value(count);
+}
+
+static mrb_value
+mrb_al_sourcepool_get_sources(mrb_state *mrb, mrb_value self)
+{
+  return mrb_iv_get(mrb, self, mrb_intern(mrb, "@sources", 8));
+}
+
+void
+mruby_openal_sourcepool_init(mrb_state *mrb)
+{
+  class_SourcePool = mrb_define_class_under(mrb, mod_AL, "SourcePool", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_SourcePool, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_SourcePool, "initialize", mrb_al_sourcepool_initialize,    ARGS_REQ(1));
+  mrb_define_method(mrb, class_SourcePool, "acquire",    mrb_al_sourcepool_acquire,       ARGS_OPT(1));
+  mrb_define_method(mrb, class_SourcePool, "release",    mrb_al_sourcepool_release,       ARGS_REQ(1));
+  mrb_define_method(mrb, class_SourcePool, "recycle",    mrb_al_sourcepool_recycle,       ARGS_NONE());
+  mrb_define_method(mrb, class_SourcePool, "size",       mrb_al_sourcepool_get_size,      ARGS_NONE());
+  mrb_define_method(mrb, class_SourcePool, "available",  mrb_al_sourcepool_get_available, ARGS_NONE());
+  mrb_define_method(mrb, class_SourcePool, "sources",    mrb_al_sourcepool_get_sources,   ARGS_NONE());
+}
+
+void
+mruby_openal_sourcepool_final(mrb_state *mrb)
+{
+}
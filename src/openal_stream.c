@@ -0,0 +1,632 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/string.h"
+#include "mruby/variable.h"
+#include <AL/al.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * compressed formats are decoded by the single-file decoders in vendor/.
+ * define MRB_OPENAL_NO_STB_VORBIS and/or MRB_OPENAL_NO_DR_FLAC to leave
+ * them out.
+ */
+#ifndef MRB_OPENAL_NO_STB_VORBIS
+#define STB_VORBIS_NO_PUSHDATA_API
+#include "stb_vorbis.c"
+#endif
+#ifndef MRB_OPENAL_NO_DR_FLAC
+#define DR_FLAC_IMPLEMENTATION
+#include "dr_flac.h"
+#endif
+
+/* bytes decoded per read by mrb_al_decode_file. */
+#define MRB_AL_DECODE_STEP 16384
+
+static struct RClass *class_Stream = NULL;
+
+typedef struct mrb_al_decoder_t {
+  char const *name;
+  void   *(*open)(char const *path, ALenum *format, ALsizei *frequency);
+  size_t  (*read)(void *handle, void *dst, size_t size);
+  bool    (*rewind)(void *handle);
+  void    (*close)(void *handle);
+} mrb_al_decoder_t;
+
+typedef struct mrb_al_stream_data_t {
+  mrb_al_decoder_t const *decoder;
+  void                   *handle;
+  ALenum                  format;
+  ALsizei                 frequency;
+  ALuint                  source;
+  ALsizei                 buffer_count;
+  ALuint                 *buffers;
+  size_t                  buffer_size;
+  unsigned char          *chunk;
+  bool                    looping;
+  bool                    eof;
+  mrb_int                 played_frames;
+} mrb_al_stream_data_t;
+
+
+typedef struct wave_stream_t {
+  FILE  *fp;
+  long   data_offset;
+  size_t data_size;
+  size_t remaining;
+} wave_stream_t;
+
+static uint32_t
+wave_le32(unsigned char const *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void*
+wave_open(char const *path, ALenum *format, ALsizei *frequency)
+{
+  FILE *fp = fopen(path, "rb");
+  if (NULL == fp) {
+    return NULL;
+  }
+  unsigned char header[24];
+  if ((12 != fread(header, 1, 12, fp)) || (0 != memcmp(header, "RIFF", 4)) || (0 != memcmp(header + 8, "WAVE", 4))) {
+    fclose(fp);
+    return NULL;
+  }
+  /* reuse the in-place parser on a synthetic image made of fmt chunk + empty data chunk. */
+  unsigned char image[12 + 8 + 16 + 8];
+  bool has_format = false;
+  while (8 == fread(header, 1, 8, fp)) {
+    uint32_t const size = wave_le32(header + 4);
+    if (0 == memcmp(header, "fmt ", 4)) {
+      if ((size < 16) || (16 != fread(image + 20, 1, 16, fp))) {
+        break;
+      }
+      if ((size > 16) && (0 != fseek(fp, (long)(size - 16 + (size & 1)), SEEK_CUR))) {
+        break;
+      }
+      has_format = true;
+    } else if (0 == memcmp(header, "data", 4)) {
+      if (!has_format) {
+        break;
+      }
+      memcpy(image, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0", 20);
+      memcpy(image + 36, "data\0\0\0\0", 8);
+      unsigned char const *pcm;
+      size_t pcm_size;
+      if (NULL != mrb_al_parse_wave(image, sizeof(image), format, frequency, &pcm, &pcm_size)) {
+        break;
+      }
+      wave_stream_t *stream = (wave_stream_t*)malloc(sizeof(wave_stream_t));
+      if (NULL == stream) {
+        break;
+      }
+      stream->fp = fp;
+      stream->data_offset = ftell(fp);
+      stream->data_size = size;
+      stream->remaining = size;
+      return stream;
+    } else if (0 != fseek(fp, (long)(size + (size & 1)), SEEK_CUR)) {
+      break;
+    }
+  }
+  fclose(fp);
+  return NULL;
+}
+
+static size_t
+wave_read(void *handle, void *dst, size_t size)
+{
+  wave_stream_t *stream = (wave_stream_t*)handle;
+  if (size > stream->remaining) {
+    size = stream->remaining;
+  }
+  size = fread(dst, 1, size, stream->fp);
+  stream->remaining -= size;
+  return size;
+}
+
+static bool
+wave_rewind(void *handle)
+{
+  wave_stream_t *stream = (wave_stream_t*)handle;
+  stream->remaining = stream->data_size;
+  return 0 == fseek(stream->fp, stream->data_offset, SEEK_SET);
+}
+
+static void
+wave_close(void *handle)
+{
+  wave_stream_t *stream = (wave_stream_t*)handle;
+  fclose(stream->fp);
+  free(stream);
+}
+
+static mrb_al_decoder_t const wave_decoder = { "wave", wave_open, wave_read, wave_rewind, wave_close };
+
+#ifndef MRB_OPENAL_NO_STB_VORBIS
+static void*
+vorbis_open(char const *path, ALenum *format, ALsizei *frequency)
+{
+  int error = 0;
+  stb_vorbis *vorbis = stb_vorbis_open_filename(path, &error, NULL);
+  if (NULL == vorbis) {
+    return NULL;
+  }
+  stb_vorbis_info const info = stb_vorbis_get_info(vorbis);
+  if ((1 != info.channels) && (2 != info.channels)) {
+    stb_vorbis_close(vorbis);
+    return NULL;
+  }
+  *format = (1 == info.channels) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+  *frequency = (ALsizei)info.sample_rate;
+  return vorbis;
+}
+
+static size_t
+vorbis_read(void *handle, void *dst, size_t size)
+{
+  stb_vorbis *vorbis = (stb_vorbis*)handle;
+  int const channels = stb_vorbis_get_info(vorbis).channels;
+  int const frames = stb_vorbis_get_samples_short_interleaved(vorbis, channels, (short*)dst, (int)(size / sizeof(short)));
+  return (size_t)frames * channels * sizeof(short);
+}
+
+static bool
+vorbis_rewind(void *handle)
+{
+  return 0 != stb_vorbis_seek_start((stb_vorbis*)handle);
+}
+
+static void
+vorbis_close(void *handle)
+{
+  stb_vorbis_close((stb_vorbis*)handle);
+}
+
+static mrb_al_decoder_t const vorbis_decoder = { "vorbis", vorbis_open, vorbis_read, vorbis_rewind, vorbis_close };
+#endif
+
+#ifndef MRB_OPENAL_NO_DR_FLAC
+static void*
+flac_open(char const *path, ALenum *format, ALsizei *frequency)
+{
+  drflac *flac = drflac_open_file(path, NULL);
+  if (NULL == flac) {
+    return NULL;
+  }
+  if ((1 != flac->channels) && (2 != flac->channels)) {
+    drflac_close(flac);
+    return NULL;
+  }
+  *format = (1 == flac->channels) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+  *frequency = (ALsizei)flac->sampleRate;
+  return flac;
+}
+
+static size_t
+flac_read(void *handle, void *dst, size_t size)
+{
+  drflac *flac = (drflac*)handle;
+  size_t const frame_size = flac->channels * sizeof(drflac_int16);
+  drflac_uint64 const frames = drflac_read_pcm_frames_s16(flac, size / frame_size, (drflac_int16*)dst);
+  return (size_t)frames * frame_size;
+}
+
+static bool
+flac_rewind(void *handle)
+{
+  return DRFLAC_TRUE == drflac_seek_to_pcm_frame((drflac*)handle, 0);
+}
+
+static void
+flac_close(void *handle)
+{
+  drflac_close((drflac*)handle);
+}
+
+static mrb_al_decoder_t const flac_decoder = { "flac", flac_open, flac_read, flac_rewind, flac_close };
+#endif
+
+/* picks a decoder by the magic number of the file. */
+static mrb_al_decoder_t const*
+mrb_al_stream_find_decoder(char const *path)
+{
+  unsigned char magic[4] = { 0, 0, 0, 0 };
+  FILE *fp = fopen(path, "rb");
+  if (NULL == fp) {
+    return NULL;
+  }
+  size_t const size = fread(magic, 1, sizeof(magic), fp);
+  fclose(fp);
+  if (sizeof(magic) != size) {
+    return NULL;
+  }
+  if (0 == memcmp(magic, "RIFF", 4)) {
+    return &wave_decoder;
+  }
+#ifndef MRB_OPENAL_NO_STB_VORBIS
+  if (0 == memcmp(magic, "OggS", 4)) {
+    return &vorbis_decoder;
+  }
+#endif
+#ifndef MRB_OPENAL_NO_DR_FLAC
+  if (0 == memcmp(magic, "fLaC", 4)) {
+    return &flac_decoder;
+  }
+#endif
+  return NULL;
+}
+
+/*
+ * decodes the whole of 'path' with the same decoders as AL::Stream into a
+ * buffer from malloc, which the caller frees.
+ * returns an error message, or NULL on success. uses neither mruby nor AL,
+ * so it is safe on worker threads.
+ */
+char const*
+mrb_al_decode_file(char const *path, ALenum *format, ALsizei *frequency, unsigned char **pcm, size_t *pcm_size)
+{
+  mrb_al_decoder_t const *decoder = mrb_al_stream_find_decoder(path);
+  if (NULL == decoder) {
+    return "unsupported file format.";
+  }
+  void *handle = decoder->open(path, format, frequency);
+  if (NULL == handle) {
+    return "cannot open file.";
+  }
+  size_t const frame_size = mrb_al_format_frame_size(*format);
+  unsigned char *buffer = NULL;
+  size_t capacity = 0;
+  size_t size = 0;
+  char const *error = NULL;
+  for (;;) {
+    if (capacity - size < MRB_AL_DECODE_STEP) {
+      size_t const grown = (0 == capacity) ? MRB_AL_DECODE_STEP * 4 : capacity * 2;
+      unsigned char *p = (unsigned char*)realloc(buffer, grown);
+      if (NULL == p) {
+        error = "insufficient memory.";
+        break;
+      }
+      buffer = p;
+      capacity = grown;
+    }
+    size_t const room = (capacity - size) - ((capacity - size) % frame_size);
+    size_t const read_size = decoder->read(handle, buffer + size, room);
+    if (0 == read_size) {
+      break;
+    }
+    size += read_size;
+    /* alBufferData takes an ALsizei. */
+    if (size > (size_t)INT_MAX) {
+      error = "PCM data is too large for a buffer.";
+      break;
+    }
+  }
+  decoder->close(handle);
+  if ((NULL == error) && (0 == size)) {
+    error = "no sample is decoded.";
+  }
+  if (NULL != error) {
+    free(buffer);
+    return error;
+  }
+  *pcm = buffer;
+  *pcm_size = size;
+  return NULL;
+}
+
+static void
+mrb_al_stream_free(mrb_state *mrb, void *p)
+{
+  mrb_al_stream_data_t *data = (mrb_al_stream_data_t*)p;
+  if (NULL != data) {
+    if (NULL != data->buffers) {
+      /* queued buffers cannot be deleted. */
+      if (alIsSource(data->source)) {
+        alSourceStop(data->source);
+        alSourcei(data->source, AL_BUFFER, AL_NONE);
+      }
+      alDeleteBuffers(data->buffer_count, data->buffers);
+      mrb_free(mrb, data->buffers);
+    }
+    if (NULL != data->handle) {
+      data->decoder->close(data->handle);
+    }
+    mrb_free(mrb, data->chunk);
+    mrb_free(mrb, data);
+  }
+}
+
+static struct mrb_data_type const mrb_al_stream_data_type = { "Stream", mrb_al_stream_free };
+
+static mrb_value
+mrb_al_stream_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)DATA_PTR(self);
+  mrb_value source, path;
+  mrb_int buffer_count = 4;
+  mrb_int buffer_size = 65536;
+  mrb_get_args(mrb, "oS|ii", &source, &path, &buffer_count, &buffer_size);
+
+  if ((buffer_count < 2) || (buffer_size <= 0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "invalid streaming parameter is supplied.");
+  }
+  mrb_al_decoder_t const *decoder = mrb_al_stream_find_decoder(RSTRING_PTR(path));
+  if (NULL == decoder) {
+    mrb_raisef(mrb, class_ALError, "unsupported stream (%S).", path);
+  }
+  ALuint const source_name = mrb_al_source_name(mrb, source);
+
+  if (NULL != data) {
+    mrb_al_stream_free(mrb, data);
+  }
+  data = (mrb_al_stream_data_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_stream_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_stream_data_type;
+
+  data->decoder = decoder;
+  data->source = source_name;
+  data->chunk = (unsigned char*)mrb_malloc(mrb, buffer_size);
+  data->buffers = (ALuint*)mrb_calloc(mrb, buffer_count, sizeof(ALuint));
+  if ((NULL == data->chunk) || (NULL == data->buffers)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  mrb_al_fetch_error();
+  alGenBuffers((ALsizei)buffer_count, data->buffers);
+  ALenum const e = mrb_al_fetch_error();
+  if (AL_NO_ERROR != e) {
+    mrb_free(mrb, data->buffers);
+    data->buffers = NULL;
+    mrb_raise(mrb, class_ALError, alGetString(e));
+  }
+  data->buffer_count = (ALsizei)buffer_count;
+  data->handle = decoder->open(RSTRING_PTR(path), &data->format, &data->frequency);
+  if (NULL == data->handle) {
+    mrb_raisef(mrb, class_ALError, "cannot open stream (%S).", path);
+  }
+  size_t const frame_size = mrb_al_format_frame_size(data->format);
+  data->buffer_size = (size_t)buffer_size - ((size_t)buffer_size % frame_size);
+  if (0 == data->buffer_size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "buffer size is smaller than a frame.");
+  }
+
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@source", 7), source);
+  return self;
+}
+
+/* decodes into one buffer. returns false when the stream has no more data. */
+static bool
+mrb_al_stream_fill(mrb_al_stream_data_t *data, ALuint buffer)
+{
+  size_t size = 0;
+  bool rewound = false;
+  while (size < data->buffer_size) {
+    size_t const read_size = data->decoder->read(data->handle, data->chunk + size, data->buffer_size - size);
+    if (0 == read_size) {
+      /* nothing right after a rewind means there is nothing to loop over. */
+      if (!data->looping || rewound || !data->decoder->rewind(data->handle)) {
+        data->eof = true;
+        break;
+      }
+      rewound = true;
+      continue;
+    }
+    rewound = false;
+    size += read_size;
+  }
+  if (0 == size) {
+    return false;
+  }
+  alBufferData(buffer, data->format, data->chunk, (ALsizei)size, data->frequency);
+  alSourceQueueBuffers(data->source, 1, &buffer);
+  return true;
+}
+
+/* drops whatever is queued, then queues every buffer from the current position and plays. */
+static void
+mrb_al_stream_start(mrb_al_stream_data_t *data)
+{
+  alSourceStop(data->source);
+  alSourcei(data->source, AL_BUFFER, AL_NONE);
+  data->played_frames = 0;
+  ALsizei i;
+  for (i = 0; i < data->buffer_count; ++i) {
+    if (!mrb_al_stream_fill(data, data->buffers[i])) {
+      break;
+    }
+  }
+  alSourcePlay(data->source);
+}
+
+static mrb_value
+mrb_al_stream_play(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  mrb_al_stream_start(data);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+/*
+ * recycles processed buffers. call this periodically, e.g. once per frame.
+ * returns false once the whole stream has been played.
+ */
+static mrb_value
+mrb_al_stream_update(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  ALint processed = 0;
+  alGetSourcei(data->source, AL_BUFFERS_PROCESSED, &processed);
+  size_t const frame_size = mrb_al_format_frame_size(data->format);
+  while (processed-- > 0) {
+    ALuint buffer = 0;
+    ALint size = 0;
+    alSourceUnqueueBuffers(data->source, 1, &buffer);
+    alGetBufferi(buffer, AL_SIZE, &size);
+    data->played_frames += (mrb_int)((size_t)size / frame_size);
+    if (!data->eof) {
+      mrb_al_stream_fill(data, buffer);
+    }
+  }
+  ALint state = AL_STOPPED;
+  ALint queued = 0;
+  alGetSourcei(data->source, AL_SOURCE_STATE, &state);
+  alGetSourcei(data->source, AL_BUFFERS_QUEUED, &queued);
+  if ((AL_STOPPED == state) && (0 < queued)) {
+    /* restart after an underrun. */
+    alSourcePlay(data->source);
+    state = AL_PLAYING;
+  }
+  mrb_al_check_error(mrb);
+  return ((AL_STOPPED == state) && data->eof) ? mrb_false_value() : mrb_true_value();
+}
+
+static mrb_value
+mrb_al_stream_stop(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  alSourceStop(data->source);
+  alSourcei(data->source, AL_BUFFER, AL_NONE);
+  data->played_frames = 0;
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_stream_rewind(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  ALint state = AL_STOPPED;
+  alGetSourcei(data->source, AL_SOURCE_STATE, &state);
+  /* buffers queued from the old position must not be heard after the rewind. */
+  alSourceStop(data->source);
+  alSourcei(data->source, AL_BUFFER, AL_NONE);
+  data->played_frames = 0;
+  if (!data->decoder->rewind(data->handle)) {
+    mrb_raise(mrb, class_ALError, "cannot rewind stream.");
+  }
+  data->eof = false;
+  if (AL_PLAYING == state) {
+    mrb_al_stream_start(data);
+  }
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_stream_is_looping(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  return data->looping ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_stream_set_looping(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  mrb_bool value;
+  mrb_get_args(mrb, "b", &value);
+  data->looping = value;
+  return value ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_stream_is_eof(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  return data->eof ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_stream_get_decoder(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  return mrb_str_new_cstr(mrb, data->decoder->name);
+}
+
+/*
+ * playback position since play: the buffers unqueued so far plus the offset
+ * into the queue, which AL resets on every unqueue.
+ * returns false when 'stream' is not an AL::Stream.
+ */
+bool
+mrb_al_stream_position(mrb_value stream, ALuint *source, double *offset, double *latency, bool *exact)
+{
+  if ((mrb_type(stream) != MRB_TT_DATA) || (DATA_TYPE(stream) != &mrb_al_stream_data_type) || (NULL == DATA_PTR(stream))) {
+    return false;
+  }
+  mrb_al_stream_data_t *data = (mrb_al_stream_data_t*)DATA_PTR(stream);
+  *source = data->source;
+  *exact = mrb_al_source_offset_latency(data->source, offset, latency);
+  if (0 < data->frequency) {
+    *offset += (double)data->played_frames / data->frequency;
+  }
+  return true;
+}
+
+/* frames of the buffers that have finished playing since play. */
+static mrb_value
+mrb_al_stream_get_played_frames(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  return mrb_fixnum_value(data->played_frames);
+}
+
+static mrb_value
+mrb_al_stream_get_frequency(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_stream_data_t *data =
+    (mrb_al_stream_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_stream_data_type);
+  return mrb_fixnum_value(data->frequency);
+}
+
+static mrb_value
+mrb_al_stream_get_source(mrb_state *mrb, mrb_value self)
+{
+  return mrb_iv_get(mrb, self, mrb_intern(mrb, "@source", 7));
+}
+
+void
+mruby_openal_stream_init(mrb_state *mrb)
+{
+  class_Stream = mrb_define_class_under(mrb, mod_AL, "Stream", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_Stream, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_Stream, "initialize",    mrb_al_stream_initialize,        ARGS_REQ(2) | ARGS_OPT(2));
+  mrb_define_method(mrb, class_Stream, "play",          mrb_al_stream_play,              ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "update",        mrb_al_stream_update,            ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "stop",          mrb_al_stream_stop,              ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "rewind",        mrb_al_stream_rewind,            ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "looping?",      mrb_al_stream_is_looping,        ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "looping=",      mrb_al_stream_set_looping,       ARGS_REQ(1));
+  mrb_define_method(mrb, class_Stream, "eof?",          mrb_al_stream_is_eof,            ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "decoder",       mrb_al_stream_get_decoder,       ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "source",        mrb_al_stream_get_source,        ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "played_frames", mrb_al_stream_get_played_frames, ARGS_NONE());
+  mrb_define_method(mrb, class_Stream, "frequency",     mrb_al_stream_get_frequency,     ARGS_NONE());
+}
+
+void
+mruby_openal_stream_final(mrb_state *mrb)
+{
+}
@@ -0,0 +1,480 @@
+#include "openal.h"
+#include "mruby/class.h"
+#include "mruby/string.h"
+#include "mruby/variable.h"
+#include <AL/al.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+static struct RClass *class_StreamingSource = NULL;
+
+typedef struct mrb_al_streaming_source_data_t {
+  ALuint          source;
+  ALsizei         buffer_count;
+  ALuint         *buffers;
+  ALsizei         idle_count;
+  ALuint         *idle_buffers;
+  ALenum          format;
+  ALsizei         frequency;
+  size_t          chunk_size;
+  unsigned char  *chunk;
+  long            period_ns;
+  mrb_al_ring_t   ring;
+  pthread_mutex_t lock;
+  pthread_t       thread;
+  bool            thread_started;
+  int             running;
+  int             want_play;
+  int             finishing;
+  bool            started;
+  mrb_int         underruns;
+  mrb_int         played_frames;
+  int             worker_error;
+} mrb_al_streaming_source_data_t;
+
+static void
+mrb_al_streaming_source_close_data(mrb_state *mrb, mrb_al_streaming_source_data_t *data)
+{
+  if (data->thread_started) {
+    __atomic_store_n(&data->running, 0, __ATOMIC_RELEASE);
+    pthread_join(data->thread, NULL);
+    pthread_mutex_destroy(&data->lock);
+    data->thread_started = false;
+  }
+  if (0 != data->source) {
+    alSourceStop(data->source);
+    alSourcei(data->source, AL_BUFFER, AL_NONE);
+    alDeleteSources(1, &data->source);
+    data->source = 0;
+  }
+  if (NULL != data->buffers) {
+    alDeleteBuffers(data->buffer_count, data->buffers);
+    mrb_free(mrb, data->buffers);
+    data->buffers = NULL;
+  }
+  mrb_free(mrb, data->idle_buffers);
+  data->idle_buffers = NULL;
+  mrb_free(mrb, data->chunk);
+  data->chunk = NULL;
+  mrb_al_ring_destroy(mrb, &data->ring);
+}
+
+static void
+mrb_al_streaming_source_free(mrb_state *mrb, void *p)
+{
+  mrb_al_streaming_source_data_t *data = (mrb_al_streaming_source_data_t*)p;
+  if (NULL != data) {
+    mrb_al_streaming_source_close_data(mrb, data);
+    mrb_free(mrb, data);
+  }
+}
+
+static struct mrb_data_type const mrb_al_streaming_source_data_type = { "StreamingSource", mrb_al_streaming_source_free };
+
+/*
+ * records the first failure of the queue for #error.
+ * alGetError is not used off the mruby thread, as it would take errors of
+ * calls made there and the other way round. a failure is told from the
+ * queue state instead, which initialize has made sure is sane.
+ */
+static void
+mrb_al_streaming_source_fail(mrb_al_streaming_source_data_t *data, int e)
+{
+  int expected = AL_NO_ERROR;
+  __atomic_compare_exchange_n(&data->worker_error, &expected, e, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/* runs with 'lock' held, on the worker thread or from play. */
+static void
+mrb_al_streaming_source_unqueue(mrb_al_streaming_source_data_t *data, bool played)
+{
+  size_t const frame_size = mrb_al_format_frame_size(data->format);
+  ALint processed = 0;
+  alGetSourcei(data->source, AL_BUFFERS_PROCESSED, &processed);
+  while (processed-- > 0) {
+    ALuint buffer = 0;
+    alSourceUnqueueBuffers(data->source, 1, &buffer);
+    if (0 == buffer) {
+      mrb_al_streaming_source_fail(data, AL_INVALID_OPERATION);
+      break;
+    }
+    if (played) {
+      ALint size = 0;
+      alGetBufferi(buffer, AL_SIZE, &size);
+      data->played_frames += (mrb_int)((size_t)size / frame_size);
+    }
+    data->idle_buffers[data->idle_count++] = buffer;
+  }
+}
+
+static void
+mrb_al_streaming_source_refill(mrb_al_streaming_source_data_t *data)
+{
+  size_t const frame_size = mrb_al_format_frame_size(data->format);
+  mrb_al_streaming_source_unqueue(data, true);
+
+  while (data->idle_count > 0) {
+    size_t size = mrb_al_ring_available(&data->ring);
+    if (size >= data->chunk_size) {
+      size = data->chunk_size;
+    } else if (!__atomic_load_n(&data->finishing, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    size -= size % frame_size;
+    if (0 == size) {
+      break;
+    }
+    mrb_al_ring_read(&data->ring, data->chunk, size);
+    ALuint const buffer = data->idle_buffers[--data->idle_count];
+    ALint queued = 0;
+    ALint requeued = 0;
+    alGetSourcei(data->source, AL_BUFFERS_QUEUED, &queued);
+    alBufferData(buffer, data->format, data->chunk, (ALsizei)size, data->frequency);
+    alSourceQueueBuffers(data->source, 1, &buffer);
+    alGetSourcei(data->source, AL_BUFFERS_QUEUED, &requeued);
+    if (requeued <= queued) {
+      /* the chunk is lost, but the buffer is kept for the next one. */
+      data->idle_buffers[data->idle_count++] = buffer;
+      mrb_al_streaming_source_fail(data, AL_INVALID_OPERATION);
+      break;
+    }
+  }
+
+  if (__atomic_load_n(&data->want_play, __ATOMIC_ACQUIRE)) {
+    ALint state = AL_INITIAL;
+    ALint queued = 0;
+    alGetSourcei(data->source, AL_SOURCE_STATE, &state);
+    if (AL_PLAYING != state) {
+      alGetSourcei(data->source, AL_BUFFERS_QUEUED, &queued);
+      if (0 < queued) {
+        if (data->started && (AL_STOPPED == state)) {
+          ++data->underruns;
+        }
+        alSourcePlay(data->source);
+        data->started = true;
+      }
+    }
+  }
+}
+
+static void*
+mrb_al_streaming_source_worker(void *p)
+{
+  mrb_al_streaming_source_data_t *data = (mrb_al_streaming_source_data_t*)p;
+  struct timespec const period = { data->period_ns / 1000000000L, data->period_ns % 1000000000L };
+  while (__atomic_load_n(&data->running, __ATOMIC_ACQUIRE)) {
+    pthread_mutex_lock(&data->lock);
+    mrb_al_streaming_source_refill(data);
+    pthread_mutex_unlock(&data->lock);
+    nanosleep(&period, NULL);
+  }
+  return NULL;
+}
+
+static mrb_value
+mrb_al_streaming_source_initialize(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data =
+    (mrb_al_streaming_source_data_t*)DATA_PTR(self);
+  mrb_int format, frequency;
+  mrb_int buffer_count = 4;
+  mrb_int chunk_size = 16384;
+  mrb_int ring_capacity = 0;
+  mrb_float period = 0.005;
+  int const argc = mrb_get_args(mrb, "ii|iiif", &format, &frequency, &buffer_count, &chunk_size, &ring_capacity, &period);
+
+  size_t const frame_size = mrb_al_format_frame_size((ALenum)format);
+  if (0 == frame_size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "unsupported format.");
+  }
+  if ((buffer_count < 2) || (chunk_size < (mrb_int)frame_size) || (period <= 0.0)) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "invalid streaming parameter is supplied.");
+  }
+  if (argc < 5) {
+    ring_capacity = chunk_size * buffer_count * 2;
+  }
+  if (ring_capacity < chunk_size) {
+    mrb_raise(mrb, E_ARGUMENT_ERROR, "ring capacity must be larger than chunk size.");
+  }
+
+  if (NULL != data) {
+    mrb_al_streaming_source_free(mrb, data);
+  }
+  data = (mrb_al_streaming_source_data_t*)mrb_calloc(mrb, 1, sizeof(mrb_al_streaming_source_data_t));
+  if (NULL == data) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+  data->buffer_count = (ALsizei)buffer_count;
+  data->format = (ALenum)format;
+  data->frequency = (ALsizei)frequency;
+  data->chunk_size = (size_t)chunk_size - ((size_t)chunk_size % frame_size);
+  data->period_ns = (long)(period * 1000000000.0);
+
+  DATA_PTR(self) = data;
+  DATA_TYPE(self) = &mrb_al_streaming_source_data_type;
+
+  mrb_al_ring_init(mrb, &data->ring, (size_t)ring_capacity);
+  data->buffers = (ALuint*)mrb_calloc(mrb, buffer_count, sizeof(ALuint));
+  data->idle_buffers = (ALuint*)mrb_malloc(mrb, sizeof(ALuint) * buffer_count);
+  data->chunk = (unsigned char*)mrb_malloc(mrb, data->chunk_size);
+  if ((NULL == data->buffers) || (NULL == data->idle_buffers) || (NULL == data->chunk)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "insufficient memory.");
+  }
+
+  mrb_al_fetch_error();
+  alGenSources(1, &data->source);
+  ALenum e = mrb_al_fetch_error();
+  if (AL_NO_ERROR != e) {
+    data->source = 0;
+    mrb_raise(mrb, class_ALError, alGetString(e));
+  }
+  alGenBuffers(data->buffer_count, data->buffers);
+  e = mrb_al_fetch_error();
+  if (AL_NO_ERROR != e) {
+    mrb_free(mrb, data->buffers);
+    data->buffers = NULL;
+    mrb_raise(mrb, class_ALError, alGetString(e));
+  }
+  /*
+   * the worker cannot read AL errors, so format and frequency are tried on
+   * a silent frame here to fail early instead of on every refill.
+   */
+  bool const unsigned8 = (AL_FORMAT_MONO8 == data->format) || (AL_FORMAT_STEREO8 == data->format);
+  memset(data->chunk, unsigned8 ? 0x80 : 0, frame_size);
+  alBufferData(data->buffers[0], data->format, data->chunk, (ALsizei)frame_size, data->frequency);
+  alSourcei(data->source, AL_SOURCE_TYPE, AL_STREAMING);
+  e = mrb_al_fetch_error();
+  if (AL_NO_ERROR != e) {
+    mrb_raise(mrb, class_ALError, alGetString(e));
+  }
+  ALsizei i;
+  for (i = 0; i < data->buffer_count; ++i) {
+    data->idle_buffers[i] = data->buffers[i];
+  }
+  data->idle_count = data->buffer_count;
+
+  if (0 != pthread_mutex_init(&data->lock, NULL)) {
+    mrb_raise(mrb, E_RUNTIME_ERROR, "cannot initialize mutex.");
+  }
+  data->running = 1;
+  if (0 != pthread_create(&data->thread, NULL, mrb_al_streaming_source_worker, data)) {
+    pthread_mutex_destroy(&data->lock);
+    mrb_raise(mrb, E_RUNTIME_ERROR, "cannot start streaming thread.");
+  }
+  data->thread_started = true;
+
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@source", 7), mrb_al_source_wrap(mrb, data->source));
+
+  return self;
+}
+
+static mrb_al_streaming_source_data_t*
+mrb_al_streaming_source_get_data(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data =
+    (mrb_al_streaming_source_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_streaming_source_data_type);
+  if (!data->thread_started) {
+    mrb_raise(mrb, class_ALError, "streaming source has already been closed.");
+  }
+  return data;
+}
+
+static mrb_value
+mrb_al_streaming_source_write(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  mrb_value samples;
+  mrb_get_args(mrb, "o", &samples);
+  size_t written;
+  if (mrb_string_p(samples)) {
+    written = mrb_al_ring_write(&data->ring, RSTRING_PTR(samples), RSTRING_LEN(samples));
+  } else {
+    mrb_al_sample_buffer_data_t *samples_data =
+      (mrb_al_sample_buffer_data_t*)mrb_data_get_ptr(mrb, samples, &mrb_al_sample_buffer_data_type);
+    written = mrb_al_ring_write(&data->ring, samples_data->buffer, samples_data->size);
+  }
+  if (0 != written) {
+    __atomic_store_n(&data->finishing, 0, __ATOMIC_RELEASE);
+  }
+  return mrb_fixnum_value(written);
+}
+
+static mrb_value
+mrb_al_streaming_source_finish(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  __atomic_store_n(&data->finishing, 1, __ATOMIC_RELEASE);
+  return self;
+}
+
+static mrb_value
+mrb_al_streaming_source_get_available(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  return mrb_fixnum_value(mrb_al_ring_available(&data->ring));
+}
+
+static mrb_value
+mrb_al_streaming_source_get_free_space(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  return mrb_fixnum_value(mrb_al_ring_free_space(&data->ring));
+}
+
+static mrb_value
+mrb_al_streaming_source_get_underruns(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  pthread_mutex_lock(&data->lock);
+  mrb_int const underruns = data->underruns;
+  pthread_mutex_unlock(&data->lock);
+  return mrb_fixnum_value(underruns);
+}
+
+/*
+ * same as mrb_al_stream_position for AL::StreamingSource. the lock keeps
+ * the worker from unqueueing between the two reads.
+ */
+bool
+mrb_al_streaming_source_position(mrb_value stream, ALuint *source, double *offset, double *latency, bool *exact)
+{
+  if ((mrb_type(stream) != MRB_TT_DATA) || (DATA_TYPE(stream) != &mrb_al_streaming_source_data_type) || (NULL == DATA_PTR(stream))) {
+    return false;
+  }
+  mrb_al_streaming_source_data_t *data = (mrb_al_streaming_source_data_t*)DATA_PTR(stream);
+  *source = data->source;
+  if (!data->thread_started) {
+    *offset = 0.0;
+    *latency = 0.0;
+    *exact = false;
+    return true;
+  }
+  pthread_mutex_lock(&data->lock);
+  *exact = mrb_al_source_offset_latency(data->source, offset, latency);
+  if (0 < data->frequency) {
+    *offset += (double)data->played_frames / data->frequency;
+  }
+  pthread_mutex_unlock(&data->lock);
+  return true;
+}
+
+/* frames of the buffers that have finished playing since the last stop. */
+static mrb_value
+mrb_al_streaming_source_get_played_frames(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  pthread_mutex_lock(&data->lock);
+  mrb_int const played_frames = data->played_frames;
+  pthread_mutex_unlock(&data->lock);
+  return mrb_fixnum_value(played_frames);
+}
+
+/* the first failure of the buffer queue since the last call, or nil. */
+static mrb_value
+mrb_al_streaming_source_get_error(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  int const e = __atomic_exchange_n(&data->worker_error, AL_NO_ERROR, __ATOMIC_ACQUIRE);
+  return (AL_NO_ERROR == e) ? mrb_nil_value() : mrb_str_new_cstr(mrb, alGetString((ALenum)e));
+}
+
+static mrb_value
+mrb_al_streaming_source_get_source(mrb_state *mrb, mrb_value self)
+{
+  return mrb_iv_get(mrb, self, mrb_intern(mrb, "@source", 7));
+}
+
+static mrb_value
+mrb_al_streaming_source_play(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  pthread_mutex_lock(&data->lock);
+  __atomic_store_n(&data->want_play, 1, __ATOMIC_RELEASE);
+  mrb_al_streaming_source_refill(data);
+  pthread_mutex_unlock(&data->lock);
+  mrb_al_check_error(mrb);
+  return self;
+}
+
+static mrb_value
+mrb_al_streaming_source_stop(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  pthread_mutex_lock(&data->lock);
+  __atomic_store_n(&data->want_play, 0, __ATOMIC_RELEASE);
+  alSourceStop(data->source);
+  /* stopping marks the whole queue processed, but it was never heard. */
+  mrb_al_streaming_source_unqueue(data, false);
+  data->played_frames = 0;
+  data->started = false;
+  pthread_mutex_unlock(&data->lock);
+  return self;
+}
+
+static mrb_value
+mrb_al_streaming_source_pause(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  pthread_mutex_lock(&data->lock);
+  __atomic_store_n(&data->want_play, 0, __ATOMIC_RELEASE);
+  alSourcePause(data->source);
+  pthread_mutex_unlock(&data->lock);
+  return self;
+}
+
+static mrb_value
+mrb_al_streaming_source_is_playing(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data = mrb_al_streaming_source_get_data(mrb, self);
+  return __atomic_load_n(&data->want_play, __ATOMIC_ACQUIRE) ? mrb_true_value() : mrb_false_value();
+}
+
+static mrb_value
+mrb_al_streaming_source_close(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data =
+    (mrb_al_streaming_source_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_streaming_source_data_type);
+  mrb_al_streaming_source_close_data(mrb, data);
+  mrb_iv_set(mrb, self, mrb_intern(mrb, "@source", 7), mrb_nil_value());
+  return self;
+}
+
+static mrb_value
+mrb_al_streaming_source_is_closed(mrb_state *mrb, mrb_value self)
+{
+  mrb_al_streaming_source_data_t *data =
+    (mrb_al_streaming_source_data_t*)mrb_data_get_ptr(mrb, self, &mrb_al_streaming_source_data_type);
+  return data->thread_started ? mrb_false_value() : mrb_true_value();
+}
+
+void
+mruby_openal_streaming_init(mrb_state *mrb)
+{
+  class_StreamingSource = mrb_define_class_under(mrb, mod_AL, "StreamingSource", mrb->object_class);
+
+  MRB_SET_INSTANCE_TT(class_StreamingSource, MRB_TT_DATA);
+
+  mrb_define_method(mrb, class_StreamingSource, "initialize",    mrb_al_streaming_source_initialize,        ARGS_REQ(2) | ARGS_OPT(4));
+  mrb_define_method(mrb, class_StreamingSource, "write",         mrb_al_streaming_source_write,             ARGS_REQ(1));
+  mrb_define_method(mrb, class_StreamingSource, "<<",            mrb_al_streaming_source_write,             ARGS_REQ(1));
+  mrb_define_method(mrb, class_StreamingSource, "finish",        mrb_al_streaming_source_finish,            ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "available",     mrb_al_streaming_source_get_available,     ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "free_space",    mrb_al_streaming_source_get_free_space,    ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "underruns",     mrb_al_streaming_source_get_underruns,     ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "error",         mrb_al_streaming_source_get_error,         ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "played_frames", mrb_al_streaming_source_get_played_frames, ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "source",        mrb_al_streaming_source_get_source,        ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "play",          mrb_al_streaming_source_play,              ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "stop",          mrb_al_streaming_source_stop,              ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "pause",         mrb_al_streaming_source_pause,             ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "playing?",      mrb_al_streaming_source_is_playing,        ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "close",         mrb_al_streaming_source_close,             ARGS_NONE());
+  mrb_define_method(mrb, class_StreamingSource, "closed?",       mrb_al_streaming_source_is_closed,         ARGS_NONE());
+}
+
+void
+mruby_openal_streaming_final(mrb_state *mrb)
+{
+}